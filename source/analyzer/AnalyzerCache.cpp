@@ -0,0 +1,83 @@
+#include "AnalyzerCache.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tb_Core.h>
+#include <utility>
+
+FftPlan::FftPlan(int size) : size_(size), fft_(size) {
+    // The scaling only depends on the FFT backend & size, neither of which changes at runtime, so
+    // it only ever gets measured for the first plan of each size. Plans getting built at the same
+    // time might both measure it, which is harmless as they come up with the same value.
+    static std::array<std::atomic<double>, 32> scales {};
+    tb_assert(size > 0 && std::has_single_bit(static_cast<unsigned>(size)));
+    auto& cached_scale = scales[static_cast<size_t>(std::countr_zero(static_cast<unsigned>(size)))];
+
+    scale_ = cached_scale.load(std::memory_order_relaxed);
+    if (scale_ > 0.0)
+        return;
+
+    // An impulse has a flat spectrum. Bin 1 is used as some implementations pack DC & Nyquist
+    // together.
+    std::vector<float> impulse(size, 0.0f);
+    impulse[0] = 1.0f;
+    std::vector<std::complex<float>> spectrum(size / 2 + 1);
+    fft_.forward(impulse.data(), spectrum.data());
+
+    scale_ = std::abs(spectrum[1]);
+    tb_assert(scale_ > 0.0);
+    cached_scale.store(scale_, std::memory_order_relaxed);
+}
+
+void FftPlan::forward(const float* in, std::complex<float>* out) { fft_.forward(in, out); }
+
+void FftPlan::forwardEach(const float* in, std::complex<float>* out, int num_transforms) {
+    const auto num_bins = static_cast<size_t>(size_ / 2 + 1);
+    for (int i = 0; i < num_transforms; ++i)
+        fft_.forward(in + static_cast<size_t>(i) * size_, out + i * num_bins);
+}
+
+namespace analyzer_cache {
+
+namespace {
+
+template <typename Key, typename T>
+class WeakCache {
+  public:
+    template <typename Create>
+    std::shared_ptr<T> get(const Key& key, Create&& create) {
+        const std::scoped_lock lock(mutex_);
+        if (auto existing = entries_[key].lock())
+            return existing;
+
+        // Building under the lock means concurrent requests for the same entry wait for the one
+        // build rather than each doing their own
+        auto entry = create();
+        entries_[key] = entry;
+
+        std::erase_if(entries_, [](const auto& e) { return e.second.expired(); });
+        return entry;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::map<Key, std::weak_ptr<T>> entries_;
+};
+
+}
+
+std::shared_ptr<const SharedWindow> window(tb::WindowType type, int size) {
+    static WeakCache<std::pair<tb::WindowType, int>, const SharedWindow> cache;
+    return cache.get({ type, size }, [&] {
+        auto window = std::make_shared<SharedWindow>();
+        window->values = tb::window<float>(type, size);
+        window->sum = std::accumulate(window->values.begin(), window->values.end(), 0.0);
+        return window;
+    });
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <complex>
+#include <FastFourier.h>
+#include <memory>
+#include <tb_Windowing.h>
+#include <vector>
+
+/**
+ * @class FftPlan
+ * @brief An FFT plan owned by a single analyzer engine.
+ *
+ * FastFourier keeps its scratch state inside the plan and doesn't promise to be reentrant, so
+ * plans don't get shared. With one per engine, forward() never takes a lock and instances don't
+ * queue up behind each other. FastFourier doesn't expose its setup separately from the scratch
+ * state, so only the windows get shared, see analyzer_cache.
+ */
+class FftPlan {
+  public:
+    explicit FftPlan(int size);
+
+    int size() const noexcept { return size_; }
+
+    /**
+     * @brief The magnitude a unit impulse comes out of forward() with, i.e. the scaling of the
+     * FFT implementation. The same for every bin. Measured once per size & process, so only the
+     * first plan of each size runs a transform to find it.
+     */
+    double scale() const noexcept { return scale_; }
+
+    void forward(const float* in, std::complex<float>* out);
+
+    /**
+     * @brief Runs forward() on `num_transforms` contiguous blocks, one after the other. Block i
+     * reads `size()` samples from `in + i * size()` and writes `size() / 2 + 1` bins to
+     * `out + i * (size() / 2 + 1)`. FastFourier has no batched transform, so this is a plain loop
+     * that only saves the callers the strides.
+     */
+    void forwardEach(const float* in, std::complex<float>* out, int num_transforms);
+
+  private:
+    const int size_;
+    FastFourier fft_;
+    double scale_ = 1.0;
+
+  public:
+    // Prevent copying & moving
+    FftPlan(const FftPlan&) = delete;
+    FftPlan& operator=(const FftPlan&) = delete;
+};
+
+/** An immutable window table, shared between analyzer instances */
+struct SharedWindow {
+    std::vector<float> values;
+    double sum = 0.0; ///< Sum of all values, i.e. the coherent gain times the size
+};
+
+/**
+ * Process-wide cache of the immutable resources that only depend on (window type, FFT size), so
+ * that any number of analyzers with the same settings share a single copy.
+ *
+ * The cache only holds weak references, so everything gets freed once the last analyzer using it
+ * lets go. All functions are thread-safe.
+ */
+namespace analyzer_cache {
+
+std::shared_ptr<const SharedWindow> window(tb::WindowType type, int size);
+
+}
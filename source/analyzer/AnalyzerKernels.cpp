@@ -0,0 +1,441 @@
+#include "AnalyzerKernels.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#if SPECTRUM_SIMD_AVX2 || SPECTRUM_SIMD_SSE2
+#include <immintrin.h>
+#elif SPECTRUM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace kernels {
+
+namespace {
+
+// -------------------------------------------------------------------------------------------------
+// Minimal SIMD abstraction. Each vector type provides the same handful of operations, so that the
+// element-wise kernels below are written once as templates. `Scalar` is the portable fallback and
+// also handles the tail elements, which keeps the results of the SIMD and tail paths consistent.
+// -------------------------------------------------------------------------------------------------
+
+struct Scalar {
+    static constexpr int size = 1;
+    float v;
+
+    Scalar(float x) : v(x) { }
+    static Scalar load(const float* p) { return *p; }
+    void store(float* p) const { *p = v; }
+
+    friend Scalar operator+(Scalar a, Scalar b) { return a.v + b.v; }
+    friend Scalar operator-(Scalar a, Scalar b) { return a.v - b.v; }
+    friend Scalar operator*(Scalar a, Scalar b) { return a.v * b.v; }
+    friend Scalar operator/(Scalar a, Scalar b) { return a.v / b.v; }
+    friend Scalar max(Scalar a, Scalar b) { return std::max(a.v, b.v); }
+
+    // a > b ? t : f
+    friend Scalar selectGreater(Scalar a, Scalar b, Scalar t, Scalar f) { return a.v > b.v ? t : f; }
+
+    // Splits a positive, normal x into a mantissa in [1, 2) and an unbiased exponent
+    friend void splitExponent(Scalar x, Scalar& mantissa, Scalar& exponent) {
+        const auto bits = std::bit_cast<uint32_t>(x.v);
+        exponent = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+        mantissa = std::bit_cast<float>((bits & 0x007fffffu) | 0x3f800000u);
+    }
+};
+
+#if SPECTRUM_SIMD_SSE2 || SPECTRUM_SIMD_AVX2
+struct Sse {
+    static constexpr int size = 4;
+    __m128 v;
+
+    Sse(__m128 x) : v(x) { }
+    Sse(float x) : v(_mm_set1_ps(x)) { }
+    static Sse load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend Sse operator+(Sse a, Sse b) { return _mm_add_ps(a.v, b.v); }
+    friend Sse operator-(Sse a, Sse b) { return _mm_sub_ps(a.v, b.v); }
+    friend Sse operator*(Sse a, Sse b) { return _mm_mul_ps(a.v, b.v); }
+    friend Sse operator/(Sse a, Sse b) { return _mm_div_ps(a.v, b.v); }
+    friend Sse max(Sse a, Sse b) { return _mm_max_ps(a.v, b.v); }
+
+    friend Sse selectGreater(Sse a, Sse b, Sse t, Sse f) {
+        const auto mask = _mm_cmpgt_ps(a.v, b.v);
+        return _mm_or_ps(_mm_and_ps(mask, t.v), _mm_andnot_ps(mask, f.v));
+    }
+
+    friend void splitExponent(Sse x, Sse& mantissa, Sse& exponent) {
+        const auto bits = _mm_castps_si128(x.v);
+        exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+        mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                                                 _mm_set1_epi32(0x3f800000)));
+    }
+};
+#endif
+
+#if SPECTRUM_SIMD_AVX2
+struct Avx {
+    static constexpr int size = 8;
+    __m256 v;
+
+    Avx(__m256 x) : v(x) { }
+    Avx(float x) : v(_mm256_set1_ps(x)) { }
+    static Avx load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    friend Avx operator+(Avx a, Avx b) { return _mm256_add_ps(a.v, b.v); }
+    friend Avx operator-(Avx a, Avx b) { return _mm256_sub_ps(a.v, b.v); }
+    friend Avx operator*(Avx a, Avx b) { return _mm256_mul_ps(a.v, b.v); }
+    friend Avx operator/(Avx a, Avx b) { return _mm256_div_ps(a.v, b.v); }
+    friend Avx max(Avx a, Avx b) { return _mm256_max_ps(a.v, b.v); }
+
+    friend Avx selectGreater(Avx a, Avx b, Avx t, Avx f) {
+        return _mm256_blendv_ps(f.v, t.v, _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ));
+    }
+
+    friend void splitExponent(Avx x, Avx& mantissa, Avx& exponent) {
+        const auto bits = _mm256_castps_si256(x.v);
+        exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                       _mm256_set1_epi32(0x3f800000)));
+    }
+};
+#endif
+
+#if SPECTRUM_SIMD_NEON
+struct Neon {
+    static constexpr int size = 4;
+    float32x4_t v;
+
+    Neon(float32x4_t x) : v(x) { }
+    Neon(float x) : v(vdupq_n_f32(x)) { }
+    static Neon load(const float* p) { return vld1q_f32(p); }
+    void store(float* p) const { vst1q_f32(p, v); }
+
+    friend Neon operator+(Neon a, Neon b) { return vaddq_f32(a.v, b.v); }
+    friend Neon operator-(Neon a, Neon b) { return vsubq_f32(a.v, b.v); }
+    friend Neon operator*(Neon a, Neon b) { return vmulq_f32(a.v, b.v); }
+    friend Neon operator/(Neon a, Neon b) { return vdivq_f32(a.v, b.v); }
+    friend Neon max(Neon a, Neon b) { return vmaxq_f32(a.v, b.v); }
+
+    friend Neon selectGreater(Neon a, Neon b, Neon t, Neon f) { return vbslq_f32(vcgtq_f32(a.v, b.v), t.v, f.v); }
+
+    friend void splitExponent(Neon x, Neon& mantissa, Neon& exponent) {
+        const auto bits = vreinterpretq_u32_f32(x.v);
+        exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+        mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+    }
+};
+#endif
+
+#if SPECTRUM_SIMD_AVX2
+using Vec = Avx;
+#elif SPECTRUM_SIMD_SSE2
+using Vec = Sse;
+#elif SPECTRUM_SIMD_NEON
+using Vec = Neon;
+#else
+using Vec = Scalar;
+#endif
+
+// Runs `f.operator()<V>(offset)` over [0, count) with the widest vector type, then the tail with Scalar
+template <typename F>
+void forEachVector(int count, F&& f) {
+    int i = 0;
+    for (; i + Vec::size <= count; i += Vec::size)
+        f.template operator()<Vec>(i);
+
+    for (; i < count; ++i)
+        f.template operator()<Scalar>(i);
+}
+
+// Maximum of `f.operator()<V>(offset)` over [0, count), with all values assumed to be >= 0
+template <typename F>
+float maxOf(int count, F&& f) {
+    int i = 0;
+    Vec max_vec = 0.0f;
+    for (; i + Vec::size <= count; i += Vec::size)
+        max_vec = max(max_vec, f.template operator()<Vec>(i));
+
+    alignas(32) float lanes[Vec::size];
+    max_vec.store(lanes);
+    auto result = *std::max_element(lanes, lanes + Vec::size);
+
+    for (; i < count; ++i)
+        result = std::max(result, f.template operator()<Scalar>(i).v);
+
+    return result;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+// 10 * log10(x) for positive, normal x. The mantissa is folded into [sqrt(1/2), sqrt(2)) and the
+// natural log of it is taken via ln(m) = 2 * atanh(t), t = (m - 1) / (m + 1), with the series
+// truncated after t^7. With |t| <= 0.1716 the truncation error is below 3e-8 nepers, i.e. below
+// 1.3e-7 dB, so the float rounding of the final result dominates (see k_fast_log_max_error_dB).
+template <typename V>
+V fastPowerToDb(V x) {
+    V mantissa = 0.0f, exponent = 0.0f;
+    splitExponent(x, mantissa, exponent);
+
+    constexpr auto sqrt2 = std::numbers::sqrt2_v<float>;
+    exponent = selectGreater(mantissa, sqrt2, exponent + 1.0f, exponent);
+    mantissa = selectGreater(mantissa, sqrt2, mantissa * 0.5f, mantissa);
+
+    const auto t = (mantissa - 1.0f) / (mantissa + 1.0f);
+    const auto t2 = t * t;
+    const auto series = V(1.0f) + t2 * (V(1.0f / 3.0f) + t2 * (V(1.0f / 5.0f) + t2 * (1.0f / 7.0f)));
+    const auto ln = V(2.0f) * t * series + exponent * std::numbers::ln2_v<float>;
+
+    constexpr auto dB_per_neper = static_cast<float>(10.0 / std::numbers::ln10);
+    return ln * dB_per_neper;
+}
+
+// Powers at or below this are clamped to the floor, which also keeps zeros, negatives and denormals
+// away from the fast log
+float floorPower(float floor_dB) {
+    return std::max(std::pow(10.0f, floor_dB / 10.0f), FLT_MIN);
+}
+
+float exactPowerToDb(float power, float floor_dB) {
+    if (power <= 0.0f)
+        return floor_dB;
+
+    return std::max(floor_dB, static_cast<float>(10.0 * std::log10(static_cast<double>(power))));
+}
+
+#if SPECTRUM_SIMD_SSE2 || SPECTRUM_SIMD_AVX2
+float horizontalMax(__m128 v) noexcept {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+// Squared magnitudes of 4 interleaved complex values, in order
+__m128 power4(const float* bins) noexcept {
+    const auto a = _mm_loadu_ps(bins);
+    const auto b = _mm_loadu_ps(bins + 4);
+    const auto a2 = _mm_mul_ps(a, a);
+    const auto b2 = _mm_mul_ps(b, b);
+    return _mm_add_ps(_mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0)),
+                      _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+#endif
+
+float maxWeightedPowerScalar(const float* bins, const float* power_weights, int count, float max_power) noexcept {
+    for (int i = 0; i < count; ++i) {
+        const auto re = bins[2 * i];
+        const auto im = bins[2 * i + 1];
+        max_power = std::max(max_power, (re * re + im * im) * power_weights[i]);
+    }
+
+    return max_power;
+}
+
+}
+
+float maxWeightedPower(const std::complex<float>* complex_bins, const float* power_weights, int count) noexcept {
+    // std::complex<float> is guaranteed to be laid out as re, im
+    const auto* bins = reinterpret_cast<const float*>(complex_bins);
+
+    int i = 0;
+    float max_power = 0.0f;
+
+#if SPECTRUM_SIMD_AVX2
+    auto max8 = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        const auto a = _mm256_loadu_ps(bins + 2 * i);
+        const auto b = _mm256_loadu_ps(bins + 2 * i + 8);
+        const auto a2 = _mm256_mul_ps(a, a);
+        const auto b2 = _mm256_mul_ps(b, b);
+
+        // The shuffles work per 128 bit lane, leaving the powers in the order 0 1 4 5 2 3 6 7
+        auto power = _mm256_add_ps(_mm256_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0)),
+                                   _mm256_shuffle_ps(a2, b2, _MM_SHUFFLE(3, 1, 3, 1)));
+        power = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(power), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        max8 = _mm256_max_ps(max8, _mm256_mul_ps(power, _mm256_loadu_ps(power_weights + i)));
+    }
+
+    auto max4 = _mm_max_ps(_mm256_castps256_ps128(max8), _mm256_extractf128_ps(max8, 1));
+    for (; i + 4 <= count; i += 4)
+        max4 = _mm_max_ps(max4, _mm_mul_ps(power4(bins + 2 * i), _mm_loadu_ps(power_weights + i)));
+
+    max_power = horizontalMax(max4);
+#elif SPECTRUM_SIMD_SSE2
+    auto max4 = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+        max4 = _mm_max_ps(max4, _mm_mul_ps(power4(bins + 2 * i), _mm_loadu_ps(power_weights + i)));
+
+    max_power = horizontalMax(max4);
+#elif SPECTRUM_SIMD_NEON
+    auto max4 = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        const auto c = vld2q_f32(bins + 2 * i); // Deinterleaves into re & im
+        const auto power = vmlaq_f32(vmulq_f32(c.val[0], c.val[0]), c.val[1], c.val[1]);
+        max4 = vmaxq_f32(max4, vmulq_f32(power, vld1q_f32(power_weights + i)));
+    }
+
+    max_power = vmaxvq_f32(max4);
+#endif
+
+    return maxWeightedPowerScalar(bins + 2 * i, power_weights + i, count - i, max_power);
+}
+
+void mixChannels(const float* const* in, int num_inputs, float* const* out, int num_outputs, const float* gains,
+                 int count) noexcept {
+    // Frames are the outer loop, so each vector of input gets read from memory once and then
+    // comes out of the cache for every further output
+    forEachVector(count, [&]<typename V>(int i) {
+        for (int output = 0; output < num_outputs; ++output) {
+            const auto* row = gains + output * num_inputs;
+            V sum = 0.0f;
+            for (int input = 0; input < num_inputs; ++input) {
+                if (row[input] != 0.0f)
+                    sum = sum + V::load(in[input] + i) * row[input];
+            }
+
+            sum.store(out[output] + i);
+        }
+    });
+}
+
+void powerToDb(const float* power, float* dB, int count, float floor_dB, bool exact) noexcept {
+    if (exact) {
+        for (int i = 0; i < count; ++i)
+            dB[i] = exactPowerToDb(power[i], floor_dB);
+
+        return;
+    }
+
+    const auto floor_power = floorPower(floor_dB);
+    forEachVector(count, [&]<typename V>(int i) {
+        const auto p = V::load(power + i);
+        selectGreater(p, floor_power, max(fastPowerToDb(p), floor_dB), floor_dB).store(dB + i);
+    });
+}
+
+void updateBandLevels(const float* power, float* target_dB, float* dB, int count,
+                      const BandLevelParameters& params) noexcept {
+    const auto floor_power = floorPower(params.floor_dB);
+    forEachVector(count, [&]<typename V>(int i) {
+        const auto p = V::load(power + i);
+
+        V target = params.floor_dB;
+        if (params.exact_log) {
+            alignas(32) float exact[V::size];
+            for (int j = 0; j < V::size; ++j)
+                exact[j] = exactPowerToDb(power[i + j], params.floor_dB);
+
+            target = V::load(exact);
+        } else {
+            target = selectGreater(p, floor_power, max(fastPowerToDb(p), params.floor_dB), params.floor_dB);
+        }
+
+        // Rising levels use the attack coefficient, falling ones the release coefficient
+        target.store(target_dB + i);
+        const auto old_dB = V::load(dB + i);
+        const auto coefficient = selectGreater(target, old_dB, params.attack, params.release);
+        (old_dB + coefficient * (target - old_dB)).store(dB + i);
+    });
+}
+
+void approachBandLevels(const float* target_dB, float* dB, int count, float attack, float release) noexcept {
+    forEachVector(count, [&]<typename V>(int i) {
+        const auto target = V::load(target_dB + i);
+        const auto old_dB = V::load(dB + i);
+        const auto coefficient = selectGreater(target, old_dB, attack, release);
+        (old_dB + coefficient * (target - old_dB)).store(dB + i);
+    });
+}
+
+void averageCrossSpectra(const std::complex<float>* complex_x, const std::complex<float>* complex_y, float* xx,
+                         float* yy, std::complex<float>* complex_xy, int count, float weight) noexcept {
+    // std::complex<float> is guaranteed to be laid out as re, im. This streams through 5 arrays
+    // for a handful of multiplies per bin, so it's bound by memory rather than arithmetic and is
+    // left as a plain loop for the compiler to vectorize.
+    const auto* x = reinterpret_cast<const float*>(complex_x);
+    const auto* y = reinterpret_cast<const float*>(complex_y);
+    auto* xy = reinterpret_cast<float*>(complex_xy);
+
+    for (int i = 0; i < count; ++i) {
+        const auto x_re = x[2 * i];
+        const auto x_im = x[2 * i + 1];
+        const auto y_re = y[2 * i];
+        const auto y_im = y[2 * i + 1];
+
+        xx[i] += weight * (x_re * x_re + x_im * x_im - xx[i]);
+        yy[i] += weight * (y_re * y_re + y_im * y_im - yy[i]);
+
+        // conj(x) * y
+        xy[2 * i] += weight * (x_re * y_re + x_im * y_im - xy[2 * i]);
+        xy[2 * i + 1] += weight * (x_re * y_im - x_im * y_re - xy[2 * i + 1]);
+    }
+}
+
+float maxAbsDifference(const float* a, const float* b, int count) noexcept {
+    return maxOf(count, [&]<typename V>(int i) {
+        const auto va = V::load(a + i);
+        const auto vb = V::load(b + i);
+        return max(va - vb, vb - va);
+    });
+}
+
+void normalize(const float* dB, float* normalized, int count, float min_dB, float max_dB) noexcept {
+    const auto scale = 1.0f / (max_dB - min_dB);
+    forEachVector(count, [&]<typename V>(int i) {
+        ((V::load(dB + i) - min_dB) * scale).store(normalized + i);
+    });
+}
+
+void catmullRomBasis(float* basis, int steps) noexcept {
+    for (int k = 0; k < steps; ++k) {
+        const auto t = static_cast<float>(k) / static_cast<float>(steps);
+        const auto t2 = t * t;
+        const auto t3 = t2 * t;
+        basis[4 * k] = 0.5f * (-t + 2.0f * t2 - t3);
+        basis[4 * k + 1] = 0.5f * (2.0f - 5.0f * t2 + 3.0f * t3);
+        basis[4 * k + 2] = 0.5f * (t + 4.0f * t2 - 3.0f * t3);
+        basis[4 * k + 3] = 0.5f * (-t2 + t3);
+    }
+}
+
+void catmullRom(const float* control, int count, const float* basis, int steps, float* out) noexcept {
+    // Vectorized across segments, one step at a time. The loads are contiguous, only the results
+    // get scattered into the interleaved output.
+    const auto num_segments = count - 3;
+    for (int k = 0; k < steps; ++k) {
+        const auto* weights = basis + 4 * k;
+        forEachVector(num_segments, [&]<typename V>(int segment) {
+            const auto value = V(weights[0]) * V::load(control + segment) +
+                               V(weights[1]) * V::load(control + segment + 1) +
+                               V(weights[2]) * V::load(control + segment + 2) +
+                               V(weights[3]) * V::load(control + segment + 3);
+
+            alignas(32) float lanes[V::size];
+            value.store(lanes);
+            for (int j = 0; j < V::size; ++j)
+                out[(segment + j) * steps + k] = lanes[j];
+        });
+    }
+
+    out[num_segments * steps] = control[count - 2];
+}
+
+void catmullRomPoints(const float* control, const int* segments, const float* weights, int count,
+                      float* out) noexcept {
+    // The control values get gathered per point, so this is left to the compiler. There are only
+    // about as many points as pixel columns anyway.
+    for (int i = 0; i < count; ++i) {
+        const auto* c = control + segments[i];
+        const auto* w = weights + 4 * i;
+        out[i] = w[0] * c[0] + w[1] * c[1] + w[2] * c[2] + w[3] * c[3];
+    }
+}
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <complex>
+
+// Pick the widest SIMD instruction set that is guaranteed to be available at compile time. There
+// is no runtime dispatch, AVX2 only gets used when the whole build targets it (e.g. -mavx2 or
+// /arch:AVX2).
+#if defined(__AVX2__)
+#define SPECTRUM_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPECTRUM_SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SPECTRUM_SIMD_NEON 1
+#endif
+
+/**
+ * Vectorized building blocks for the analyzer's hot loops. Each kernel has a portable scalar
+ * fallback that gets used for the tail elements and on platforms without a SIMD path.
+ */
+namespace kernels {
+
+/**
+ * @brief Returns the maximum weighted power of a run of FFT bins, i.e. the maximum of
+ * `|bins[i]|^2 * power_weights[i]` over `[0, count)`.
+ *
+ * Working on squared magnitudes avoids a sqrt per bin, so the weights need to be pre-squared.
+ * Returns 0 if `count` is 0.
+ */
+float maxWeightedPower(const std::complex<float>* bins, const float* power_weights, int count) noexcept;
+
+/**
+ * @brief Mixes `num_inputs` channels into `num_outputs` channels through a matrix of gains, in a
+ * single pass over the frames for all outputs, i.e.
+ * `out[o][i] = sum over c of gains[o * num_inputs + c] * in[c][i]`.
+ *
+ * Inputs with a gain of 0 don't get read at all, so selecting channels costs no more than a copy.
+ * The outputs must not overlap the inputs.
+ */
+void mixChannels(const float* const* in, int num_inputs, float* const* out, int num_outputs, const float* gains,
+                 int count) noexcept;
+
+/**
+ * Maximum absolute error of the fast power to dB conversion against an exact double precision
+ * reference, for powers above the floor. The approximation itself is accurate to about 1e-7 dB, the
+ * rest is float rounding of large results (roughly 1e-6 relative).
+ */
+inline constexpr float k_fast_log_max_error_dB = 0.001f;
+
+/**
+ * @brief Converts powers to dB, i.e. `dB[i] = max(floor_dB, 10 * log10(power[i]))`.
+ *
+ * Powers that are zero, negative or denormal end up at `floor_dB`. Unless `exact` is set, this uses
+ * a polynomial approximation of the log that stays within k_fast_log_max_error_dB.
+ */
+void powerToDb(const float* power, float* dB, int count, float floor_dB, bool exact) noexcept;
+
+struct BandLevelParameters {
+    float floor_dB  = -100.0f;
+    float attack    = 1.0f;  ///< Smoothing coefficient in [0, 1] for rising levels, 1 being instant
+    float release   = 1.0f;  ///< Smoothing coefficient in [0, 1] for falling levels, 1 being instant
+    bool exact_log  = false; ///< Use std::log10 rather than the fast approximation
+};
+
+/**
+ * @brief Converts new band powers to dB, stores them in `target_dB` and applies attack/release
+ * ballistics to the current band levels in `dB`, in a single pass.
+ *
+ * Per band this is `target = powerToDb(power)` followed by `dB += c * (target - dB)`, where `c` is
+ * the attack coefficient if the level rises and the release coefficient otherwise.
+ */
+void updateBandLevels(const float* power, float* target_dB, float* dB, int count,
+                      const BandLevelParameters& params) noexcept;
+
+/**
+ * @brief Moves band levels further towards targets from an earlier updateBandLevels, i.e.
+ * `dB += c * (target_dB - dB)` with `c` picked as in updateBandLevels. Used to keep the ballistics
+ * going in between new targets.
+ */
+void approachBandLevels(const float* target_dB, float* dB, int count, float attack, float release) noexcept;
+
+/**
+ * @brief Blends the auto & cross spectra of one more pair of FFT frames into running averages,
+ * i.e. `xx += weight * (|x|^2 - xx)`, `yy += weight * (|y|^2 - yy)` and
+ * `xy += weight * (conj(x) * y - xy)` per bin.
+ *
+ * A weight of 1 / n for the n-th frame gives the plain mean of all frames so far, as in Welch's
+ * method. Capping it turns this into an exponential average over the most recent frames.
+ */
+void averageCrossSpectra(const std::complex<float>* x, const std::complex<float>* y, float* xx, float* yy,
+                         std::complex<float>* xy, int count, float weight) noexcept;
+
+/** Returns the maximum of `|a[i] - b[i]|` over `[0, count)`, or 0 if `count` is 0. */
+float maxAbsDifference(const float* a, const float* b, int count) noexcept;
+
+/** Maps dB values linearly so that `min_dB` becomes 0 and `max_dB` becomes 1. */
+void normalize(const float* dB, float* normalized, int count, float min_dB, float max_dB) noexcept;
+
+/**
+ * @brief Fills `basis` with the 4 uniform Catmull-Rom weights for each of the `steps` parameter
+ * values `t = k / steps`, i.e. `4 * steps` floats.
+ *
+ * The weights only depend on t, not on the control points, so they can be computed once and reused
+ * for every segment of every line with the same number of steps.
+ */
+void catmullRomBasis(float* basis, int steps) noexcept;
+
+/**
+ * @brief Evaluates a uniform Catmull-Rom spline through `count` control values, using a basis from
+ * catmullRomBasis.
+ *
+ * Each of the `count - 3` segments contributes `steps` values, followed by the second to last
+ * control value to close off the line, so `out` needs `(count - 3) * steps + 1` floats. The spline
+ * is linear in the control values, so x and y can be evaluated independently. `count` must be at
+ * least 4.
+ */
+void catmullRom(const float* control, int count, const float* basis, int steps, float* out) noexcept;
+
+/**
+ * @brief Evaluates a Catmull-Rom spline at individually placed points, for when the segments
+ * don't all get the same number of steps.
+ *
+ * Point i is `sum(weights[4 * i + k] * control[segments[i] + k])` over the 4 control values of its
+ * segment, with weights taken from catmullRomBasis.
+ */
+void catmullRomPoints(const float* control, const int* segments, const float* weights, int count,
+                      float* out) noexcept;
+
+}
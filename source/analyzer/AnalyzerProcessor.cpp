@@ -1,45 +1,527 @@
 
-#include "choc/audio/choc_SampleBufferUtilities.h"
-#include <choc/audio/choc_Oscillators.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <numeric>
 #include <tb_Denormals.h>
 #include <tb_Math.h>
 
+#include "AnalyzerKernels.h"
 #include "AnalyzerProcessor.h"
 
 namespace {
 
-// Currently, we only support 1 channel
-constexpr int k_num_channels = 1;
+// How far the analysis may lag behind the audio thread before hops start getting skipped
+constexpr double k_max_backlog_seconds = 0.25;
+
+// How long audio has to stop coming in before it gets treated as silence
+constexpr double k_audio_stall_seconds = 0.2;
+
+// A backlog of hops gets worked through in chunks of this many, releasing the analysis lock in
+// between so that reconfiguration doesn't have to wait for all of it
+constexpr int k_max_hops_per_lock = 4;
+
+// Time constant of the analysis load average
+constexpr double k_load_averaging_seconds = 1.0;
+
+// Band level changes below this aren't visible, so the analysis counts as converged
+constexpr float k_converged_threshold_dB = 0.01f;
+
+using Engine = AnalyzerProcessor::Engine;
+
+// Adds 2 control points on each end of the line. This ensures the spline function has enough
+// control points to work with on the ends and reduces the chances of encountering interpolation
+// artifacts at the ends.
+//
+// The offset for these extra points is derived from the spacing between the real, neighboring
+// points rather than a fixed constant. With low FFT sizes the bands near the low end of the
+// (log-scaled) frequency axis can end up extremely close together in x, so a fixed offset can be
+// larger than, comparable to, or even smaller than the real spacing there. That mismatch causes
+// the Catmull-Rom tangent at the endpoint to become unstable, producing a visible cusp. Scaling
+// the offset from the local spacing keeps the added points consistent with the curvature the
+// spline is already following, and a small minimum guards against a zero/near-zero delta if two
+// points happen to coincide.
+std::vector<float> withEndPoints(const std::vector<float>& x) {
+    constexpr float min_fudge_factor = 0.0001f;
+
+    const auto start_delta = std::max(x[1] - x[0], min_fudge_factor);
+    const auto end_delta = std::max(x[x.size() - 1] - x[x.size() - 2], min_fudge_factor);
+
+    std::vector<float> control_x = { x.front() - 2.0f * start_delta, x.front() - start_delta };
+    control_x.insert(control_x.end(), x.begin(), x.end());
+    control_x.push_back(x.back() + end_delta);
+    control_x.push_back(x.back() + 2.0f * end_delta);
+    return control_x;
+}
+
+// The line's layout, worked out off to the side & then moved into the engine, so that the analysis
+// doesn't have to wait for it. See the Engine members of the same names.
+struct LineLayout {
+    AnalyzerProcessor::LineResolution resolution;
+    size_t first_band = 0;
+    size_t last_band = 0;
+    std::vector<int> group_offsets;
+    std::vector<float> band_y;
+    std::vector<float> control_x;
+    std::vector<float> control_y;
+    int steps = 0;
+    std::vector<float> spline_basis;
+    std::vector<int> segments;
+    std::vector<float> weights;
+    std::vector<float> x;
+    std::vector<float> y;
+};
+
+// Works out the line's band range, per-column reduction, interpolation steps & x values for a
+// display of the given width & view, see AnalyzerProcessor::setLineResolution. Only reads the
+// engine's band layout & parameters, which never change, so this doesn't need the analysis lock.
+LineLayout layoutLine(const Engine& engine, const AnalyzerProcessor::LineResolution& resolution) {
+    LineLayout layout;
+    layout.resolution = resolution;
+
+    // Only the bands in view, plus one on each side so that the line reaches the edges. At the
+    // ends of the range, all of the extra bands beyond it stay in, as without a view.
+    const auto& band_x = engine.band_x;
+    const auto num_columns = resolution.num_columns;
+    layout.first_band = 0;
+    layout.last_band = band_x.size();
+    if (num_columns > 0) {
+        if (resolution.min_x > 0.0f) {
+            const auto first = std::ranges::upper_bound(band_x, resolution.min_x) - band_x.begin();
+            layout.first_band = static_cast<size_t>(std::max<ptrdiff_t>(first - 1, 0));
+        }
+
+        if (resolution.max_x < 1.0f) {
+            const auto last = std::ranges::lower_bound(band_x, resolution.max_x) - band_x.begin();
+            layout.last_band = std::min(static_cast<size_t>(last) + 1, band_x.size());
+        }
+
+        // The spline's end points need at least 2 bands to go by
+        if (layout.last_band - layout.first_band < 2) {
+            layout.last_band = std::min(layout.first_band + 2, band_x.size());
+            layout.first_band = layout.last_band - 2;
+        }
+    }
+
+    // Group the bands by pixel column. Columns with more than 2 bands get reduced to their min &
+    // max, placed at the column's first & last x so that the x values stay fixed. This happens
+    // before any interpolation, so dense bands only cost a pass over their levels.
+    const auto columns_per_x = static_cast<float>(num_columns) / (resolution.max_x - resolution.min_x);
+    auto& offsets = layout.group_offsets;
+    std::vector<float> points_x;
+    bool any_reduced = false;
+    if (num_columns > 0) {
+        const auto column_of = [&](float x) {
+            return static_cast<int>(std::floor((x - resolution.min_x) * columns_per_x));
+        };
+
+        for (auto first = layout.first_band; first < layout.last_band;) {
+            auto last = first + 1;
+            while (last < layout.last_band && column_of(band_x[last]) == column_of(band_x[first]))
+                ++last;
+
+            offsets.push_back(static_cast<int>(first - layout.first_band));
+            if (last - first > 2) {
+                points_x.push_back(band_x[first]);
+                points_x.push_back(band_x[last - 1]);
+                any_reduced = true;
+            } else {
+                points_x.insert(points_x.end(), band_x.begin() + first, band_x.begin() + last);
+            }
+
+            first = last;
+        }
+
+        offsets.push_back(static_cast<int>(layout.last_band - layout.first_band));
+    }
+
+    if (any_reduced) {
+        layout.band_y.resize(layout.last_band - layout.first_band);
+    } else {
+        offsets.clear();
+        points_x.assign(band_x.begin() + layout.first_band, band_x.begin() + layout.last_band);
+    }
+
+    const auto num_channels = static_cast<size_t>(engine.params.num_channels);
+    const auto max_steps = engine.params.line_interpolation_steps;
+    if (max_steps == 0) {
+        layout.x = std::move(points_x);
+    } else {
+        layout.control_x = withEndPoints(points_x);
+        layout.control_y.assign(layout.control_x.size() * num_channels, 0.0f);
+        const auto num_control_points = static_cast<int>(layout.control_x.size());
+
+        if (num_columns == 0) {
+            // Without a display to match, every segment gets the same steps
+            layout.steps = max_steps;
+            layout.spline_basis.resize(4 * max_steps);
+            kernels::catmullRomBasis(layout.spline_basis.data(), max_steps);
+            layout.x.resize((num_control_points - 3) * max_steps + 1);
+            kernels::catmullRom(layout.control_x.data(), num_control_points, layout.spline_basis.data(),
+                                max_steps, layout.x.data());
+        } else {
+            // More steps than pixel columns in a gap between two points can't be resolved, so each
+            // segment gets as many steps as the columns it spans. Segments within a column don't
+            // get interpolated at all.
+            std::vector<std::vector<float>> bases(max_steps + 1);
+            for (int steps = 1; steps <= max_steps; ++steps) {
+                bases[steps].resize(4 * steps);
+                kernels::catmullRomBasis(bases[steps].data(), steps);
+            }
+
+            for (int segment = 0; segment + 3 < num_control_points; ++segment) {
+                const auto gap = layout.control_x[segment + 2] - layout.control_x[segment + 1];
+                const auto steps = std::clamp(static_cast<int>(std::ceil(gap * columns_per_x)), 1, max_steps);
+                layout.steps = std::max(layout.steps, steps);
+                layout.segments.insert(layout.segments.end(), steps, segment);
+                layout.weights.insert(layout.weights.end(), bases[steps].begin(), bases[steps].end());
+            }
+
+            // Close off the line on the second to last control point, as kernels::catmullRom does
+            layout.segments.push_back(num_control_points - 4);
+            layout.weights.insert(layout.weights.end(), { 0.0f, 0.0f, 1.0f, 0.0f });
+
+            layout.x.resize(layout.segments.size());
+            kernels::catmullRomPoints(layout.control_x.data(), layout.segments.data(), layout.weights.data(),
+                                      static_cast<int>(layout.segments.size()), layout.x.data());
+        }
+    }
+
+    layout.y.assign(layout.x.size() * num_channels, 0.0f);
+    return layout;
+}
+
+void applyLineLayout(Engine& engine, LineLayout&& layout) {
+    engine.line_resolution = layout.resolution;
+    engine.line_first_band = layout.first_band;
+    engine.line_last_band = layout.last_band;
+    engine.line_group_offsets = std::move(layout.group_offsets);
+    engine.band_y = std::move(layout.band_y);
+    engine.control_x = std::move(layout.control_x);
+    engine.control_y = std::move(layout.control_y);
+    engine.line_steps = layout.steps;
+    engine.spline_basis = std::move(layout.spline_basis);
+    engine.line_segments = std::move(layout.segments);
+    engine.line_weights = std::move(layout.weights);
+    engine.line_x = std::move(layout.x);
+    engine.line_y = std::move(layout.y);
+}
+
+// Resamples the band levels of one engine onto the bands of another by log frequency, linearly
+// interpolating between bands & holding the outermost levels beyond the ends. Channels that the
+// previous engine didn't have, e.g. a newly added reference, start at the floor.
+void remapBandLevels(const Engine& from, Engine& to, float floor_dB) {
+    const auto log_frequency = [](const Engine& engine, size_t band) {
+        const auto min_log = std::log2(engine.params.min_frequency);
+        const auto max_log = std::log2(engine.params.max_frequency);
+        return min_log + engine.band_x[band] * (max_log - min_log);
+    };
+
+    const auto num_from_bands = from.band_x.size();
+    const auto num_to_bands = to.band_x.size();
+    for (int channel = 0; channel < to.params.num_channels; ++channel) {
+        auto* to_dB = to.band_dB.data() + static_cast<size_t>(channel) * num_to_bands;
+        if (channel >= from.params.num_channels) {
+            std::fill_n(to_dB, num_to_bands, floor_dB);
+            continue;
+        }
+
+        const auto* from_dB = from.band_dB.data() + static_cast<size_t>(channel) * num_from_bands;
+
+        size_t lower = 0;
+        for (size_t band = 0; band < num_to_bands; ++band) {
+            // Both layouts are sorted by frequency, so the matching bands only ever move up
+            const auto freq = log_frequency(to, band);
+            while (lower + 1 < num_from_bands && log_frequency(from, lower + 1) < freq)
+                ++lower;
+
+            const auto lower_freq = log_frequency(from, lower);
+            if (lower + 1 == num_from_bands || freq <= lower_freq) {
+                to_dB[band] = from_dB[lower];
+                continue;
+            }
+
+            const auto upper_freq = log_frequency(from, lower + 1);
+            const auto t = (freq - lower_freq) / (upper_freq - lower_freq);
+            to_dB[band] = from_dB[lower] + t * (from_dB[lower + 1] - from_dB[lower]);
+        }
+    }
+}
+
+// Moves the band levels towards the latest hop's levels, by the audio time between the last move
+// & `position`. Large FFT sizes can have hops that span many analysis calls, so rather than only
+// moving the levels when a hop completes, they keep moving with every call.
+void advanceBallistics(Engine& engine, uint64_t position, float attack_rate, float release_rate) {
+    if (position <= engine.ballistics_position)
+        return;
+
+    const auto seconds = static_cast<double>(position - engine.ballistics_position) / engine.params.sample_rate;
+    engine.ballistics_position = position;
+    kernels::approachBandLevels(engine.band_target_dB.data(), engine.band_dB.data(),
+                                static_cast<int>(engine.band_dB.size()),
+                                static_cast<float>(std::clamp(attack_rate * seconds, 0.0, 1.0)),
+                                static_cast<float>(std::clamp(release_rate * seconds, 0.0, 1.0)));
+}
+
+// Reduces each group of bands of a channel to its min & max, in the order they occur
+void reduceBands(const std::vector<int>& offsets, const float* y, float* out) {
+    for (size_t group = 0; group + 1 < offsets.size(); ++group) {
+        const auto first = offsets[group];
+        const auto last = offsets[group + 1];
+        if (last - first <= 2) {
+            out = std::copy(y + first, y + last, out);
+            continue;
+        }
+
+        const auto [min, max] = std::minmax_element(y + first, y + last);
+        *out++ = min < max ? *min : *max;
+        *out++ = min < max ? *max : *min;
+    }
+}
+
+// Updates the lines of all channels from the current band levels
+void updateLine(Engine& engine, float min_dB, float max_dB) {
+    const auto reduce = ! engine.line_group_offsets.empty();
+    const auto num_bands = engine.band_x.size();
+    const auto num_line_bands = static_cast<int>(engine.line_last_band - engine.line_first_band);
+    const auto num_control_points = engine.control_x.size();
+    const auto num_points = engine.line_x.size();
+
+    for (size_t channel = 0; channel < static_cast<size_t>(engine.params.num_channels); ++channel) {
+        const auto* band_dB = engine.band_dB.data() + channel * num_bands + engine.line_first_band;
+        auto* line_y = engine.line_y.data() + channel * num_points;
+
+        // When smoothing, the (reduced) levels become the spline's control values, skipping the
+        // extra control points at the front
+        auto* control_y = num_control_points > 0 ? engine.control_y.data() + channel * num_control_points : nullptr;
+        auto* points_y = control_y != nullptr ? control_y + 2 : line_y;
+        if (reduce) {
+            kernels::normalize(band_dB, engine.band_y.data(), num_line_bands, min_dB, max_dB);
+            reduceBands(engine.line_group_offsets, engine.band_y.data(), points_y);
+        } else {
+            kernels::normalize(band_dB, points_y, num_line_bands, min_dB, max_dB);
+        }
+
+        if (control_y == nullptr)
+            continue;
+
+        if (engine.line_segments.empty()) {
+            kernels::catmullRom(control_y, static_cast<int>(num_control_points), engine.spline_basis.data(),
+                                engine.line_steps, line_y);
+        } else {
+            kernels::catmullRomPoints(control_y, engine.line_segments.data(), engine.line_weights.data(),
+                                      static_cast<int>(num_points), line_y);
+        }
+    }
+}
+
+// Starts the transfer function's averages over, e.g. after a reset
+void resetTransferFunction(Engine& engine, float floor_dB) {
+    engine.num_cross_frames = 0;
+    std::ranges::fill(engine.cross_xx, 0.0f);
+    std::ranges::fill(engine.cross_yy, 0.0f);
+    std::ranges::fill(engine.cross_xy, 0.0f);
+    std::ranges::fill(engine.transfer_dB, floor_dB);
+    std::ranges::fill(engine.transfer_phase, 0.0f);
+    std::ranges::fill(engine.transfer_coherence, 0.0f);
+}
+
+// Reduces the averaged auto & cross spectra onto the bands. The gain & coherence are taken per bin
+// and then averaged over the band, weighted by the reference power Sxx. Summing the cross spectrum
+// over the bins first would cancel out wherever the phase turns within a band, e.g. with a delay.
+//
+// The lowest band also holds DC & the bins below the frequency range, which the level path weights
+// out, see prepareEngine. They'd skew the lowest band here, so they get skipped the same way.
+void updateTransferFunction(Engine& engine, float floor_dB) {
+    for (size_t band = 0; band < engine.band_x.size(); ++band) {
+        float xx_sum = 0.0f;
+        float gain_sum = 0.0f;
+        float coherence_sum = 0.0f;
+        std::complex<float> xy_sum = 0.0f;
+        for (auto bin = engine.band_bin_offsets[band]; bin < engine.band_bin_offsets[band + 1]; ++bin) {
+            const auto xx = engine.cross_xx[bin];
+            if (xx <= 0.0f || bin == 0 || engine.bin_power_weights[bin] == 0.0f)
+                continue;
+
+            // Sxx * |H|^2 = |Sxy|^2 / Sxx & Sxx * coherence = |Sxy|^2 / Syy
+            const auto xy_power = std::norm(engine.cross_xy[bin]);
+            const auto yy = engine.cross_yy[bin];
+            xx_sum += xx;
+            gain_sum += xy_power / xx;
+            coherence_sum += yy > 0.0f ? std::min(xx, xy_power / yy) : 0.0f;
+            xy_sum += engine.cross_xy[bin];
+        }
+
+        const auto has_signal = xx_sum > 0.0f && gain_sum > 0.0f;
+        engine.transfer_dB[band] = has_signal ? std::max(floor_dB, 10.0f * std::log10(gain_sum / xx_sum)) : floor_dB;
+        engine.transfer_phase[band] = std::arg(xy_sum);
+        engine.transfer_coherence[band] = has_signal ? coherence_sum / xx_sum : 0.0f;
+    }
+}
 
 }
 
 AnalyzerProcessor::AnalyzerProcessor() {
-    updateBands();
+    setNonRealtimeParameters(non_realtime_params_);
+}
+
+AnalyzerProcessor::~AnalyzerProcessor() {
+    stopAnalysisThread();
 }
 
 const std::vector<tb::Point>& AnalyzerProcessor::spectrumLine() const {
-    if (! smoothed_line_.empty())
-        return smoothed_line_;
+    if (std::exchange(spectrum_line_stale_, false)) {
+        const auto x = xs();
+        const auto y = ys();
+        spectrum_line_.resize(x.size());
+        for (size_t i = 0; i < x.size(); ++i)
+            spectrum_line_[i] = { x[i], y[i] };
+    }
 
-    return bands_line_;
+    return spectrum_line_;
+}
+
+std::span<const float> AnalyzerProcessor::xs() const noexcept {
+    // The x values come from the engine that produced the frame, so the two always match up
+    return frames_.readBuffer().engine->line_x;
+}
+
+std::span<const float> AnalyzerProcessor::ys(int channel) const noexcept {
+    const auto& frame = frames_.readBuffer();
+    tb_assert(channel >= 0 && channel < frame.engine->params.num_channels);
+    const auto num_points = frame.engine->line_x.size();
+    return std::span(frame.line_y).subspan(static_cast<size_t>(channel) * num_points, num_points);
+}
+
+int AnalyzerProcessor::numChannels() const noexcept {
+    return frames_.readBuffer().engine->params.num_channels;
+}
+
+uint64_t AnalyzerProcessor::xsVersion() const noexcept {
+    return frames_.readBuffer().engine->line_x_version;
 }
 
 void AnalyzerProcessor::setNonRealtimeParameters(NonRealtimeParameters p) {
-    tb_assert(p.sample_rate > 0.0);
-    tb_assert(p.target_num_bands >= 1);
-    tb_assert(p.fft_size >= 32 && tb::isPowerOf2(p.fft_size));
-    tb_assert(p.min_frequency > 0.0f);
-    tb_assert(p.max_frequency > 0.0f);
-    tb_assert(p.min_frequency < p.max_frequency);
-    tb_assert(p.weighting_center_frequency > 0.0f);
-    tb_assert(p.line_interpolation_steps >= 0);
+    auto engine = takeCachedEngine(p);
+    setEngine(engine != nullptr ? std::move(engine) : prepareEngine(p));
+}
+
+void AnalyzerProcessor::setEngine(std::shared_ptr<Engine> engine) {
+    tb_assert(engine != nullptr);
+
+    // The engine was built without holding any locks, while the audio & analysis threads carried
+    // on with the current one
+    non_realtime_params_ = engine->params;
+
+    // The display might have changed size since the engine was built
+    const auto line_resolution = requestedLineResolution();
+    if (engine->line_resolution != line_resolution)
+        applyLineLayout(*engine, layoutLine(*engine, line_resolution));
+
+    // Engines from the cache come back with their ring wherever it was left, so (re)start the
+    // analysis from wherever the audio thread is going to start writing
+    engine->reset_position = engine->sample_ring->writePosition();
+    engine->next_hop_end = engine->reset_position + engine->hop_size;
+    engine->last_write_position = engine->reset_position;
+    engine->ballistics_position = engine->reset_position;
+    engine->seconds_without_audio = 0.0;
+
+    // Only the band levels get carried over, the transfer function's averages start over
+    resetTransferFunction(*engine, min_dB_.load(std::memory_order_relaxed));
+
+    // Plenty of reconfigurations (e.g. the window type) keep the band layout as is
+    if (analysis_engine_ == nullptr || analysis_engine_->line_x != engine->line_x)
+        ++line_x_version_;
+
+    engine->line_x_version = line_x_version_;
+
+    // From here on, the audio thread writes into the new engine's ring. The analysis side starts
+    // reading it right after, so no audio gets lost in between.
+    audio_engine_.exchange(engine.get());
+    const auto audio_epoch = audio_epoch_.load();
 
     {
-        const std::scoped_lock lock(mutex_);
-        non_realtime_params_ = p;
-        updateBands();
+        const std::scoped_lock lock(analysis_mutex_);
+
+        // Pick up where the current engine left off, rather than starting over from the floor
+        if (analysis_engine_ != nullptr)
+            remapBandLevels(*analysis_engine_, *engine, min_dB_.load(std::memory_order_relaxed));
+
+        // The levels hold until the new engine's first hop
+        engine->band_target_dB = engine->band_dB;
+
+        engine->published_min_dB = min_dB_.load(std::memory_order_relaxed);
+        engine->published_max_dB = max_dB_.load(std::memory_order_relaxed);
+        updateLine(*engine, engine->published_min_dB, engine->published_max_dB);
+
+        std::swap(analysis_engine_, engine);
+        converged_.store(false, std::memory_order_relaxed);
+
+        // Make sure the consumer sees the new layout right away rather than with the next analysis
+        publishFrame();
+    }
+
+    updateFrame();
+    frame_picked_up_elsewhere_ = true;
+
+    // engine now holds the previous engine, which the audio thread might still be writing into
+    if (engine)
+        retired_engines_.push_back({ std::move(engine), audio_epoch });
+
+    collectRetiredEngines();
+}
+
+void AnalyzerProcessor::collectRetiredEngines() {
+    // The audio thread can only still be using a retired engine if it was inside processAudio when
+    // the engine got swapped out (odd epoch), and hasn't left it since (same epoch). Any later
+    // processAudio call already picks up the newer engine.
+    const auto audio_epoch = audio_epoch_.load();
+    std::erase_if(retired_engines_, [this, audio_epoch](RetiredEngine& retired) {
+        if (retired.audio_epoch % 2 != 0 && retired.audio_epoch == audio_epoch)
+            return false;
+
+        cacheEngine(std::move(retired.engine));
+        return true;
+    });
+}
+
+void AnalyzerProcessor::cacheEngine(std::shared_ptr<Engine> engine) {
+    if (engine_cache_capacity_ == 0)
+        return;
+
+    std::erase_if(engine_cache_, [&](const auto& cached) { return cached->params == engine->params; });
+    if (engine_cache_.size() >= engine_cache_capacity_)
+        engine_cache_.pop_back();
+
+    engine_cache_.insert(engine_cache_.begin(), std::move(engine));
+}
+
+std::shared_ptr<AnalyzerProcessor::Engine> AnalyzerProcessor::takeCachedEngine(const NonRealtimeParameters& params) {
+    collectRetiredEngines();
+
+    const auto it = std::ranges::find_if(engine_cache_, [&](const auto& cached) { return cached->params == params; });
+    if (it == engine_cache_.end()) {
+        ++engine_cache_misses_;
+        return nullptr;
     }
+
+    ++engine_cache_hits_;
+    auto engine = std::move(*it);
+    engine_cache_.erase(it);
+    return engine;
+}
+
+void AnalyzerProcessor::setEngineCacheCapacity(size_t capacity) {
+    engine_cache_capacity_ = capacity;
+    if (engine_cache_.size() > capacity)
+        engine_cache_.resize(capacity);
+}
+
+AnalyzerProcessor::EngineCacheStats AnalyzerProcessor::engineCacheStats() const noexcept {
+    return { .size = engine_cache_.size(),
+             .capacity = engine_cache_capacity_,
+             .hits = engine_cache_hits_,
+             .misses = engine_cache_misses_ };
 }
 
 void AnalyzerProcessor::setMinDb(float min_dB) {
@@ -53,145 +535,385 @@ void AnalyzerProcessor::setMaxDb(float max_dB) {
 }
 
 void AnalyzerProcessor::processAudio(choc::buffer::ChannelArrayView<float> audio) {
-    tb_assert(audio.getNumChannels() == k_num_channels);
-
-    // Is realtime safe as long as no "non-real-time" parameters are changed. In that case, this
-    // has a small potential to briefly block while the OS notifies the main thread on the unlock
-    // call to the mutex
-    const std::unique_lock lock(mutex_, std::try_to_lock);
-    if (! lock.owns_lock())
-        return; // Try to avoid blocking the audio thread as much as possible
-
-    audio = audio.getEnd(std::min(audio.getNumFrames(), static_cast<uint32_t>(fifo_buffer_->capacity())));
-    fifo_buffer_->pop(static_cast<int>(audio.getNumFrames()) - fifo_buffer_->freeSpace());
-    fifo_buffer_->push(audio);
-    if (fifo_buffer_->isFull()) {
-        RealtimeObject::ScopedAccess<farbot::ThreadType::realtime> fft_buffer(*transfer_buffer_);
-        choc::buffer::copy(choc::buffer::createMonoView(fft_buffer->data(), fft_buffer->size()),
-                           fifo_buffer_->getBuffer().getChannel(0));
-    }
+    // Announce that we're using the engine, so that it doesn't get freed under our feet. Both
+    // this and the pointer load are sequentially consistent, pairing up with the exchange & epoch
+    // load in setNonRealtimeParameters.
+    audio_epoch_.fetch_add(1);
+    writeAudio(*audio_engine_.load(), audio);
+    audio_epoch_.fetch_add(1, std::memory_order_release);
+}
+
+void AnalyzerProcessor::writeAudio(Engine& engine, choc::buffer::ChannelArrayView<float> audio) {
+    // Only the new samples get written, all channels at once. The analyzer side pulls the full FFT
+    // window itself.
+    const auto num_channels = static_cast<int>(audio.getNumChannels());
+    if (num_channels != engine.params.num_channels)
+        return;
+
+    std::array<const float*, k_max_channels> channels {};
+    for (int channel = 0; channel < num_channels; ++channel)
+        channels[channel] = audio.getIterator(static_cast<choc::buffer::ChannelCount>(channel)).sample;
+
+    engine.sample_ring->write(channels.data(), static_cast<int>(audio.getNumFrames()));
 }
 
 void AnalyzerProcessor::processAudio(float** audio_buffers, int channels, int frames) {
-    tb_assert(channels == k_num_channels);
     processAudio(choc::buffer::createChannelArrayView(audio_buffers, channels, frames));
 }
 
-void AnalyzerProcessor::processAnalyzer(double delta_time_seconds) {
-    const tb::FlushDenormalsToZero flush_denormals;
+bool AnalyzerProcessor::processAnalyzer(double delta_time_seconds) {
+    collectRetiredEngines();
 
-    const auto attack = std::clamp(attack_.load(std::memory_order_relaxed) * delta_time_seconds, 0.0, 1.0);
-    const auto release = std::clamp(release_.load(std::memory_order_relaxed) * delta_time_seconds, 0.0, 1.0);
+    if (! isAnalysisThreadRunning()) {
+        std::unique_lock lock(analysis_mutex_);
+        analyze(lock, delta_time_seconds);
+    }
 
-    const auto min_dB = static_cast<double>(min_dB_.load(std::memory_order_relaxed));
-    const auto max_dB = static_cast<double>(max_dB_.load(std::memory_order_relaxed));
+    // Frames picked up by setEngine or reset count as new too
+    const auto picked_up_new_frame = updateFrame();
+    return std::exchange(frame_picked_up_elsewhere_, false) || picked_up_new_frame;
+}
+
+void AnalyzerProcessor::startAnalysisThread(double rate_hz) {
+    stopAnalysisThread();
+    setAnalysisRate(rate_hz);
+
+    analysis_thread_ = std::thread([this] {
+        using Clock = std::chrono::steady_clock;
+
+        auto last_time = Clock::now();
+
+        std::unique_lock lock(analysis_mutex_);
+        while (! stop_analysis_thread_) {
+            const auto now = Clock::now();
+            analyze(lock, std::chrono::duration<double>(now - last_time).count());
+            last_time = now;
+
+            // Releases the lock while waiting, which is when reconfiguration gets a chance to run
+            const auto period = std::chrono::duration<double>(1.0 / analysisRate());
+            analysis_cv_.wait_until(lock, now + std::chrono::duration_cast<Clock::duration>(period),
+                                    [this] { return stop_analysis_thread_; });
+        }
+    });
+}
+
+void AnalyzerProcessor::setAnalysisRate(double rate_hz) {
+    tb_assert(rate_hz > 0.0);
+    analysis_rate_hz_.store(rate_hz, std::memory_order_relaxed);
+}
+
+void AnalyzerProcessor::stopAnalysisThread() {
+    if (! analysis_thread_.joinable())
+        return;
 
-    // Grab the latest block of audio from the audio thread
     {
-        RealtimeObject::ScopedAccess<farbot::ThreadType::nonRealtime> fft_buffer(*transfer_buffer_);
-        choc::buffer::copyRemappingChannels(fft_in_buffer_,
-                                            choc::buffer::createMonoView(fft_buffer->data(),
-                                                                         fft_buffer->size()));
+        const std::scoped_lock lock(analysis_mutex_);
+        stop_analysis_thread_ = true;
     }
 
-    // Apply windowing
-    applyGainPerFrame(fft_in_buffer_, [this](auto i) { return window_[i]; });
+    analysis_cv_.notify_all();
+    analysis_thread_.join();
+    stop_analysis_thread_ = false;
+}
+
+void AnalyzerProcessor::analyze(std::unique_lock<std::mutex>& lock, double delta_time_seconds) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
 
-    // Run FFT
-    fft_->forward(fft_in_buffer_.getIterator(0).sample, fft_output_.data());
+    runAnalysis(lock, delta_time_seconds);
 
-    for (int i = 0; i < bands_.size(); ++i) {
-        auto& band = bands_[i];
-        double band_energy = 0.0;
-        for (auto bin : band.bins) {
-            double mag = std::abs(fft_output_[bin]);
+    // Keep a running average of the load, i.e. the time spent analyzing per time passed
+    if (delta_time_seconds > 0.0) {
+        const auto busy_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const auto load = analysis_load_.load(std::memory_order_relaxed);
+        const auto smoothing = 1.0 - std::exp(-delta_time_seconds / k_load_averaging_seconds);
+        const auto new_load = load + smoothing * (busy_seconds / delta_time_seconds - load);
+        analysis_load_.store(static_cast<float>(new_load), std::memory_order_relaxed);
+    }
+}
 
-            mag *= bin_weights_[bin]; // Includes dB/octave slope & FFT normalization factors
+void AnalyzerProcessor::runAnalysis(std::unique_lock<std::mutex>& lock, double delta_time_seconds) {
+    const tb::FlushDenormalsToZero flush_denormals;
 
-            const auto bin_energy = mag * mag;
+    // Held on to, as the lock gets released in between chunks of hops, see below
+    const auto engine_in_use = analysis_engine_;
+    auto& engine = *engine_in_use;
+    const auto fft_size = static_cast<uint64_t>(engine.params.fft_size);
+    const auto hop_size = static_cast<uint64_t>(engine.hop_size);
+    const auto write_position = engine.sample_ring->writePosition();
+
+    // If we've fallen so far behind that the oldest pending hops were already overwritten, skip
+    // ahead to the oldest hop that is still safely readable. A hop's worth of slack is left for
+    // the audio thread to keep writing while we copy.
+    const auto ring_capacity = static_cast<uint64_t>(engine.sample_ring->capacity());
+    if (write_position + fft_size + hop_size > ring_capacity) {
+        const auto oldest_hop_end = write_position + fft_size + hop_size - ring_capacity;
+        if (engine.next_hop_end < oldest_hop_end)
+            engine.next_hop_end += (oldest_hop_end - engine.next_hop_end + hop_size - 1) / hop_size * hop_size;
+    }
 
-            // Take the max bin to ensure we include the peak
-            band_energy = std::max(band_energy, bin_energy);
+    bool transfer_function_changed = false;
+    if (write_position == engine.last_write_position) {
+        // No new audio, so there are no hops to process. Hosts with large blocks can leave gaps
+        // between blocks that span several analysis calls, so only once the audio has stopped for
+        // a while do we treat it as silence and let the levels keep falling.
+        engine.seconds_without_audio += delta_time_seconds;
+        if (engine.seconds_without_audio > k_audio_stall_seconds) {
+            const auto release = std::clamp(release_.load(std::memory_order_relaxed) * delta_time_seconds, 0.0, 1.0);
+            std::ranges::fill(engine.band_target_dB, min_dB_.load(std::memory_order_relaxed));
+            kernels::approachBandLevels(engine.band_target_dB.data(), engine.band_dB.data(),
+                                        static_cast<int>(engine.band_dB.size()), static_cast<float>(release),
+                                        static_cast<float>(release));
+        }
+    } else {
+        // Process every hop that has become available since the last call, in order. A backlog
+        // can be up to k_max_backlog_seconds long, so the lock gets released every few hops to let
+        // setEngine & setLineResolution in. If the engine got swapped out in the meantime, the
+        // new one starts over from where the audio is now, so the rest of the backlog is moot.
+        int hops_since_lock = 0;
+        for (; engine.next_hop_end <= write_position; engine.next_hop_end += hop_size) {
+            if (hops_since_lock++ == k_max_hops_per_lock) {
+                hops_since_lock = 1;
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+
+                if (analysis_engine_ != engine_in_use)
+                    return;
+            }
+
+            processHop(engine, engine.next_hop_end);
         }
 
-        // Convert energy to dB
-        double dB = min_dB;
-        if (band_energy > 0.0)
-            dB = std::max(min_dB, 10.0 * std::log10(band_energy));
+        // Keep the levels moving towards the latest hop's, even if no hop completed
+        advanceBallistics(engine, write_position, attack_.load(std::memory_order_relaxed),
+                          release_.load(std::memory_order_relaxed));
 
-        // Calculate ballistics
-        {
-            const double old_dB = band.dB;
-            if (dB > old_dB)
-                dB = attack * dB + (1.0 - attack) * old_dB;
-            else
-                dB = release * dB + (1.0 - release) * old_dB;
+        engine.seconds_without_audio = 0.0;
+        engine.last_write_position = write_position;
+
+        // Only the latest averages get shown, so the bands only need updating once per analysis
+        if (engine.params.transfer_function)
+            updateTransferFunction(engine, min_dB_.load(std::memory_order_relaxed));
+
+        transfer_function_changed = engine.params.transfer_function;
+    }
+
+    // Only redo the line & hand out a new frame if something visibly changed
+    const auto min_dB = min_dB_.load(std::memory_order_relaxed);
+    const auto max_dB = max_dB_.load(std::memory_order_relaxed);
+    const auto change = kernels::maxAbsDifference(engine.band_dB.data(), engine.published_dB.data(),
+                                                  static_cast<int>(engine.band_dB.size()));
+    const auto converged = change <= k_converged_threshold_dB && ! transfer_function_changed &&
+                           min_dB == engine.published_min_dB && max_dB == engine.published_max_dB;
+    converged_.store(converged, std::memory_order_relaxed);
+    if (converged)
+        return;
+
+    engine.published_min_dB = min_dB;
+    engine.published_max_dB = max_dB;
+
+    updateLine(engine, min_dB, max_dB);
+    publishFrame();
+}
 
-            band.dB = dB;
+void AnalyzerProcessor::processHop(Engine& engine, uint64_t end_position) {
+    // Ballistics run in audio time, so they don't depend on how often we get called. Whatever
+    // audio time is left since the last analysis call goes towards this hop's levels.
+    const auto seconds = static_cast<double>(end_position - std::min(engine.ballistics_position, end_position)) /
+                         engine.params.sample_rate;
+    const kernels::BandLevelParameters level_params {
+        .floor_dB = min_dB_.load(std::memory_order_relaxed),
+        .attack = static_cast<float>(std::clamp(attack_.load(std::memory_order_relaxed) * seconds, 0.0, 1.0)),
+        .release = static_cast<float>(std::clamp(release_.load(std::memory_order_relaxed) * seconds, 0.0, 1.0)),
+        .exact_log = engine.params.exact_log,
+    };
+
+    // Grab the window of audio ending at this hop, for every channel. A read only fails if the
+    // audio thread lapped us while copying, in which case the hop is lost anyway.
+    const auto num_channels = engine.params.num_channels;
+    const auto fft_size = engine.params.fft_size;
+    const auto& window = engine.window->values;
+    for (int channel = 0; channel < num_channels; ++channel) {
+        auto* fft_in = engine.fft_in.data() + static_cast<size_t>(channel) * fft_size;
+        if (! engine.sample_ring->read(fft_in, fft_size, end_position, channel))
+            return;
+
+        // Silence anything that arrived before the last reset
+        if (end_position < engine.reset_position + fft_size) {
+            const auto num_stale = std::min<uint64_t>(engine.reset_position + fft_size - end_position, fft_size);
+            std::fill_n(fft_in, num_stale, 0.0f);
         }
 
-        int bands_line_index = i;
-        if (! smoothed_line_.empty())
-            bands_line_index += 2; // Because we added extra control points onto the smoothed line
+        // Apply windowing
+        for (int i = 0; i < fft_size; ++i)
+            fft_in[i] *= window[i];
+    }
 
-        bands_line_[bands_line_index].y = static_cast<float>((dB - min_dB) / (max_dB - min_dB));
+    // The channels' windowed blocks sit back to back, so they get transformed in one sweep
+    engine.fft->forwardEach(engine.fft_in.data(), engine.fft_output.data(), num_channels);
+
+    // The transfer function reuses the FFTs from above. Following Welch's method, the first frames
+    // are averaged evenly, after which this turns into an exponential average over about as many.
+    const auto num_bins = static_cast<size_t>(fft_size / 2 + 1);
+    if (engine.params.transfer_function) {
+        engine.num_cross_frames = std::min(engine.num_cross_frames + 1, engine.params.transfer_averages);
+        const auto* reference = engine.fft_output.data() + static_cast<size_t>(num_channels - 1) * num_bins;
+        kernels::averageCrossSpectra(reference, engine.fft_output.data(), engine.cross_xx.data(),
+                                     engine.cross_yy.data(), engine.cross_xy.data(), static_cast<int>(num_bins),
+                                     1.0f / static_cast<float>(engine.num_cross_frames));
     }
 
-    if (! smoothed_line_.empty()) {
-        tb::catmullRom::spline(smoothed_line_, bands_line_, nonRealtimeParameters().line_interpolation_steps,
-                       tb::catmullRom::Type::Uniform);
+    // Channels are the inner loop, so that each band's weights get loaded once for all of them
+    const auto num_bands = engine.band_x.size();
+    for (size_t band = 0; band < num_bands; ++band) {
+        // Take the max bin to ensure we include the peak. The weights include the dB/octave
+        // slope & FFT normalization factors, squared since this works on power.
+        const auto first_bin = engine.band_bin_offsets[band];
+        const auto band_num_bins = engine.band_bin_offsets[band + 1] - first_bin;
+        const auto* weights = engine.bin_power_weights.data() + first_bin;
+        for (size_t channel = 0; channel < static_cast<size_t>(num_channels); ++channel) {
+            const auto* bins = engine.fft_output.data() + channel * num_bins + first_bin;
+            engine.band_power[channel * num_bands + band] = kernels::maxWeightedPower(bins, weights, band_num_bins);
+        }
     }
+
+    // Convert to dB & apply ballistics for all bands of all channels in one go
+    kernels::updateBandLevels(engine.band_power.data(), engine.band_target_dB.data(), engine.band_dB.data(),
+                              static_cast<int>(engine.band_dB.size()), level_params);
+    engine.ballistics_position = std::max(engine.ballistics_position, end_position);
+}
+
+void AnalyzerProcessor::publishFrame() {
+    // Copy-assigning reuses the frame's existing storage, so this doesn't allocate once the
+    // frames have been filled in
+    auto& engine = *analysis_engine_;
+    auto& frame = frames_.writeBuffer();
+    frame.engine = analysis_engine_;
+    frame.band_dB = engine.band_dB;
+    engine.published_dB = engine.band_dB;
+    frame.line_y = engine.line_y;
+    frame.transfer_dB = engine.transfer_dB;
+    frame.transfer_phase = engine.transfer_phase;
+    frame.transfer_coherence = engine.transfer_coherence;
+    frames_.publish();
 }
 
 void AnalyzerProcessor::reset() {
-    fifo_buffer_->clear();
+    {
+        const std::scoped_lock lock(analysis_mutex_);
+        resetState();
+    }
+
+    updateFrame();
+    frame_picked_up_elsewhere_ = true;
+}
+
+void AnalyzerProcessor::setLineResolution(int num_columns, float min_x, float max_x) {
+    tb_assert(num_columns >= 0 && min_x < max_x);
+    line_columns_.store(num_columns, std::memory_order_relaxed);
+    line_min_x_.store(min_x, std::memory_order_relaxed);
+    line_max_x_.store(max_x, std::memory_order_relaxed);
+
+    // Only setEngine swaps out the analysis engine, on this same thread, and the layout only reads
+    // what never changes. So the new layout gets worked out without holding up the analysis, and
+    // the lock is only needed to move it in.
+    auto& engine = *analysis_engine_;
+    const auto resolution = requestedLineResolution();
+    if (engine.line_resolution == resolution)
+        return;
+
+    auto layout = layoutLine(engine, resolution);
+
+    {
+        const std::scoped_lock lock(analysis_mutex_);
+
+        // Only the line changes, the band levels carry on as they are
+        applyLineLayout(engine, std::move(layout));
+        engine.line_x_version = ++line_x_version_;
+
+        engine.published_min_dB = min_dB_.load(std::memory_order_relaxed);
+        engine.published_max_dB = max_dB_.load(std::memory_order_relaxed);
+        updateLine(engine, engine.published_min_dB, engine.published_max_dB);
+        publishFrame();
+    }
+
+    updateFrame();
+    frame_picked_up_elsewhere_ = true;
+}
+
+bool AnalyzerProcessor::updateFrame() {
+    const auto picked_up_new_frame = frames_.update();
+    spectrum_line_stale_ |= picked_up_new_frame;
+    return picked_up_new_frame;
+}
+
+void AnalyzerProcessor::resetState() {
+    auto& engine = *analysis_engine_;
+    engine.reset_position = engine.sample_ring->writePosition();
+    engine.next_hop_end = engine.reset_position + engine.hop_size;
+    engine.last_write_position = engine.reset_position;
+    engine.ballistics_position = engine.reset_position;
+    engine.seconds_without_audio = 0.0;
 
     const auto min_dB = min_dB_.load(std::memory_order_relaxed);
-    for (auto& band : bands_)
-        band.dB = min_dB;
+    std::fill(engine.band_dB.begin(), engine.band_dB.end(), min_dB);
+    std::fill(engine.band_target_dB.begin(), engine.band_target_dB.end(), min_dB);
+    resetTransferFunction(engine, min_dB);
+
+    std::fill(engine.control_y.begin(), engine.control_y.end(), 0.0f);
+    std::fill(engine.line_y.begin(), engine.line_y.end(), 0.0f);
+
+    // Make sure the next analysis redraws the line, whatever the dB range
+    engine.published_min_dB = std::numeric_limits<float>::quiet_NaN();
+    converged_.store(false, std::memory_order_relaxed);
+
+    // Make sure the consumer sees the reset right away rather than with the next analysis
+    publishFrame();
 }
 
-void AnalyzerProcessor::updateBands() {
+std::shared_ptr<AnalyzerProcessor::Engine> AnalyzerProcessor::prepareEngine(const NonRealtimeParameters& p) const {
+    tb_assert(p.sample_rate > 0.0);
+    tb_assert(p.target_num_bands >= 1);
+    tb_assert(p.fft_size >= 32 && tb::isPowerOf2(p.fft_size));
+    tb_assert(p.min_frequency > 0.0f);
+    tb_assert(p.max_frequency > 0.0f);
+    tb_assert(p.min_frequency < p.max_frequency);
+    tb_assert(p.weighting_center_frequency > 0.0f);
+    tb_assert(p.line_interpolation_steps >= 0);
+    tb_assert(p.overlap >= 0.0f && p.overlap < 1.0f);
+    tb_assert(p.num_channels >= 1 && p.num_channels <= k_max_channels);
+    tb_assert(! p.transfer_function || p.num_channels >= 2);
+    tb_assert(p.transfer_averages >= 1);
+
     const tb::FlushDenormalsToZero flushDenormals;
 
-    const auto& p = nonRealtimeParameters();
+    auto engine = std::make_shared<Engine>();
+    engine->params = p;
+    engine->hop_size = std::max(1, static_cast<int>(std::lround(p.fft_size * (1.0 - p.overlap))));
 
     const auto num_bins = p.fft_size / 2 + 1;
 
-    window_ = tb::window<float>(p.window_type, p.fft_size);
-    fifo_buffer_ = std::make_unique<tb::FifoBuffer<float>>(k_num_channels, p.fft_size);
-    fft_in_buffer_.resize({ .numChannels = k_num_channels, .numFrames = static_cast<uint32_t>(p.fft_size) });
-    fft_ = std::make_unique<FastFourier>(p.fft_size);
-    transfer_buffer_ = std::make_unique<RealtimeObject>(std::vector<float>(p.fft_size));
-    fft_output_.resize(num_bins);
-
-    // Calculate the normalization factor. This is based on such variables such as FFT
-    // algorithm, samplerate, windowing functions, etc.
-    double normalization_factor = 1.0;
+    // The window is shared with any other analyzers using the same settings. The FFT plan holds
+    // scratch state, so each engine has its own and the analysis never waits on another instance.
+    engine->window = analyzer_cache::window(p.window_type, p.fft_size);
+    engine->fft = std::make_unique<FftPlan>(p.fft_size);
+    engine->fft_in.resize(static_cast<size_t>(p.fft_size) * p.num_channels);
 
-    {
-        // First, generate a sinusoid at the weighting center frequency
-        auto signal = choc::oscillator::createChannelArraySine<float>(
-            { .numChannels = 1, .numFrames = static_cast<uint32_t>(p.fft_size) },
-            p.weighting_center_frequency, p.sample_rate);
-        choc::buffer::applyGainPerFrame(signal, [this](auto i) { return window_[i]; });
-
-        // Run the FFT and then extract the peak magnitude
-        std::vector<std::complex<float>> fft_out(num_bins);
-        fft_->forward(signal.getIterator(0).sample, fft_out.data());
-        double max_mag = 0.0;
-        for (auto v : fft_out) {
-            const auto mag = std::abs(v);
-            if (mag > max_mag)
-                max_mag = mag;
-        }
+    // Besides the FFT window itself, the ring holds enough audio for the analyzer side to fall
+    // behind by a while without missing hops, and gives the audio thread headroom to keep writing
+    // while the analyzer side is copying out a window
+    const auto backlog = std::max(p.fft_size, static_cast<int>(p.sample_rate * k_max_backlog_seconds));
+    engine->sample_ring = std::make_unique<SampleRing>(p.fft_size + backlog, p.num_channels);
+    engine->fft_output.resize(static_cast<size_t>(num_bins) * p.num_channels);
 
-        normalization_factor = 1.0 / max_mag;
-    }
+    // Calculate the normalization factor, such that a full scale sine that sits right on a bin
+    // reads as 0 dB. Its bin magnitude is the FFT's scaling times the window's coherent gain
+    // (sum / N) times N / 2.
+    const auto normalization_factor = 1.0 / (engine->fft->scale() * engine->window->sum / 2.0);
 
     const auto delta_freq = p.sample_rate / p.fft_size;
 
-    tb_assert(p.min_frequency > 0.0f && p.min_frequency < p.max_frequency);
     const double visual_min_log = std::log2(p.min_frequency);
     const double visual_max_log = std::log2(p.max_frequency);
 
@@ -204,13 +926,23 @@ void AnalyzerProcessor::updateBands() {
     const auto min_log = visual_min_log - std::max(log_bin_width, log_band_width);
     const auto max_log = visual_max_log + std::max(log_bin_width, log_band_width);
 
-    bands_.clear();
-    bands_.resize(std::ceil((max_log - min_log) / log_band_width));
+    auto& bin_power_weights = engine->bin_power_weights;
+    bin_power_weights.resize(num_bins);
+
+    // Assign all bins to their respective bands. Bins are visited in ascending order, so every
+    // band is a contiguous run of bins and the whole layout boils down to one start offset per
+    // band. Bands that would end up without any bins are skipped so we don't have gaps.
+    auto& band_bin_offsets = engine->band_bin_offsets;
+    auto& band_x = engine->band_x;
 
-    bin_weights_.clear();
-    bin_weights_.resize(num_bins);
+    const auto to_x = [&](double log_freq) {
+        return static_cast<float>((log_freq - visual_min_log) / (visual_max_log - visual_min_log));
+    };
 
-    // Assign all bin indices into their respective bands
+    [[maybe_unused]] const auto max_num_bands = static_cast<int>(std::ceil((max_log - min_log) / log_band_width));
+    int current_band_index = -1;
+    int num_bins_in_band = 0;
+    int end_bin = 0;
     for (int i = 0; i < num_bins; ++i) {
         const auto freq = i * delta_freq;
 
@@ -221,76 +953,56 @@ void AnalyzerProcessor::updateBands() {
             continue;
 
         const auto band_index = static_cast<int>((log_freq - min_log) / log_band_width);
-        tb_assert(band_index >= 0 && band_index < bands_.size());
-        bands_[band_index].bins.push_back(i);
+        tb_assert(band_index >= 0 && band_index < max_num_bands);
+        if (band_index != current_band_index) {
+            // A single bin band just uses the actual frequency position of that bin
+            band_bin_offsets.push_back(i);
+            band_x.push_back(to_x(log_freq));
+            current_band_index = band_index;
+            num_bins_in_band = 0;
+        }
+
+        // Bands with more than one bin sit at their center frequency
+        if (++num_bins_in_band == 2)
+            band_x.back() = to_x(min_log + (band_index + 0.5) * log_band_width);
+
+        end_bin = i + 1;
 
         // Calculate dB/octave slope weighting
         const auto octaves = log_freq - std::log2(p.weighting_center_frequency);
         const auto weight = std::pow(10.0, (octaves * p.weighting_db_per_octave) / 20.0);
 
         // Assign the value to our weights buffer. Make sure to also include the FFT
-        // normalization factor we calculated earlier.
-        bin_weights_[i] = static_cast<float>(weight * normalization_factor);
-        tb_assert(std::isfinite(bin_weights_[i]));
+        // normalization factor we calculated earlier. Squared, as the bands are reduced in power.
+        const auto magnitude_weight = weight * normalization_factor;
+        bin_power_weights[i] = static_cast<float>(magnitude_weight * magnitude_weight);
+        tb_assert(std::isfinite(bin_power_weights[i]));
     }
 
-    // Now update the x positions for each band
-    constexpr auto invalid_x = std::numeric_limits<float>::max();
-    bands_line_.clear();
-    bands_line_.resize(bands_.size(), {invalid_x, 1.0});
-
-    for (int i = 0; i < bands_.size(); ++i) {
-        const auto num_bins_in_band = bands_[i].bins.size();
-        if (num_bins_in_band == 1) {
-            // Just use the actual frequency position of the single bin
-            const auto bin_freq = bands_[i].bins[0] * delta_freq;
-            const auto log_bin_freq = bin_freq > 0.0 ? std::log2(bin_freq) : min_log;
-            const auto x_0to1 = (log_bin_freq - visual_min_log) / (visual_max_log - visual_min_log);
-            bands_line_[i].x = static_cast<float>(x_0to1);
-        } else if (num_bins_in_band > 1) {
-            const auto log_center_freq = min_log + i * log_band_width + 0.5 * log_band_width;
-            const auto x_0to1 = (log_center_freq - visual_min_log) / (visual_max_log - visual_min_log);
-            bands_line_[i].x = static_cast<float>(x_0to1);
-        }
+    // Close off the last band. Note that bins skipped between two bands (only ever the ones just
+    // above DC) end up at the tail of the lower band, which is harmless as their weight is zero.
+    band_bin_offsets.push_back(end_bin);
+    const auto num_band_levels = band_x.size() * p.num_channels;
+    engine->band_dB.resize(num_band_levels, min_dB_.load(std::memory_order_relaxed));
+    engine->band_target_dB.resize(num_band_levels, min_dB_.load(std::memory_order_relaxed));
+    engine->band_power.resize(num_band_levels);
+    engine->published_dB.resize(num_band_levels);
+
+    // All of the transfer function's state gets allocated up front, so that the analysis doesn't
+    // need to allocate
+    if (p.transfer_function) {
+        engine->cross_xx.resize(num_bins);
+        engine->cross_yy.resize(num_bins);
+        engine->cross_xy.resize(num_bins);
+        engine->transfer_dB.resize(band_x.size(), min_dB_.load(std::memory_order_relaxed));
+        engine->transfer_phase.resize(band_x.size());
+        engine->transfer_coherence.resize(band_x.size());
     }
 
-    // Now remove all the bands that don't have any bins assigned to them so we don't have gaps
-    std::erase_if(bands_, [](const Band& band) { return band.bins.empty(); });
-    std::erase_if(bands_line_, [](const tb::Point& point) { return point.x == invalid_x; });
-
-    // If smoothing is enabled, we need to prep the smoothed line and add some control points
-    smoothed_line_.clear();
-    if (p.line_interpolation_steps > 0) {
-        // Here we're adding 2 control points on the front and end of the line. This ensures the
-        // spline function has enough control points to work with on the ends and reduces the
-        // chances of encountering interpolation artifacts at the ends.
-        //
-        // The offset for these extra points is derived from the spacing between the real,
-        // neighboring points rather than a fixed constant. With low FFT sizes the bands near the
-        // low end of the (log-scaled) frequency axis can end up extremely close together in x, so
-        // a fixed offset can be larger than, comparable to, or even smaller than the real spacing
-        // there. That mismatch causes the Catmull-Rom tangent at the endpoint to become unstable,
-        // producing a visible cusp. Scaling the offset from the local spacing keeps the added
-        // points consistent with the curvature the spline is already following, and a small
-        // minimum guards against a zero/near-zero delta if two points happen to coincide.
-
-        constexpr float min_fudge_factor = 0.0001f;
-
-        const auto first_x = bands_line_.front().x;
-        const auto second_x = bands_line_[1].x;
-        const auto start_delta = std::max(second_x - first_x, min_fudge_factor);
-        bands_line_.insert(bands_line_.begin(), { first_x - start_delta, 0.0f });
-        bands_line_.insert(bands_line_.begin(), { first_x - 2.0f * start_delta, 0.0f });
-
-        const auto last_x = bands_line_.back().x;
-        const auto second_last_x = bands_line_[bands_line_.size() - 2].x;
-        const auto end_delta = std::max(last_x - second_last_x, min_fudge_factor);
-        bands_line_.push_back({ last_x + end_delta, 0.0f });
-        bands_line_.push_back({ last_x + 2.0f * end_delta, 0.0f });
-
-        // Set the proper line size now so that we avoid re-allocating while running
-        smoothed_line_.resize(tb::catmullRom::outLineSize(bands_line_.size(), p.line_interpolation_steps));
-    }
+    // The spline is linear in the control values and the x values never change, so the spline's
+    // control points, the output x values, the spline weights & the per-column reduction are all
+    // worked out here, once
+    applyLineLayout(*engine, layoutLine(*engine, requestedLineResolution()));
 
-    reset();
+    return engine;
 }
\ No newline at end of file
@@ -1,14 +1,24 @@
 #pragma once
 
+#include <atomic>
 #include <choc/audio/choc_SampleBuffers.h>
 #include <complex>
-#include <farbot/RealtimeObject.hpp>
-#include <FastFourier.h>
-#include <tb_FifoBuffer.h>
+#include <concepts>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
 #include <tb_Interpolation.h>
-#include <tb_Windowing.h>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "AnalyzerCache.h"
+#include "SampleRing.h"
+#include "TripleBuffer.h"
+
 /**
  * @class AnalyzerProcessor
  * @brief Real-time audio spectrum analyzer that processes audio data and outputs a vector of line
@@ -19,7 +29,12 @@
  * smoothing, auto-normalization), and provides data for spectrum visualization with ballistics
  * (attack/release).
  *
- * @note Currently, only a channel count of 1 (mono) is supported.
+ * Any number of channels up to k_max_channels can be analyzed side by side, see
+ * NonRealtimeParameters::num_channels. All channels share one FFT plan, window & band layout and
+ * get transformed as a single batch, each ending up with its own spectrum.
+ *
+ * With NonRealtimeParameters::transfer_function set, the FFTs that are computed anyway also get
+ * used to measure the transfer function from the last channel to the first, see transferFunction.
  *
  * Example:
  *
@@ -36,19 +51,28 @@
  *
  * // Main thread, called every draw callback
  * analyzer.processAnalyzer(timeInSecondsSinceLastDrawCallback);
- * const auto& line = analyzer.spectrumLine();
+ * const auto xs = analyzer.xs();
+ * const auto ys = analyzer.ys();
  * canvas.startLine();
- * for (const auto& point : line)
- *     canvas.drawLineTo(point.x * canvas.width(), (1.0f - point.y) * canvas.height());
+ * for (size_t i = 0; i < xs.size(); ++i)
+ *     canvas.drawLineTo(xs[i] * canvas.width(), (1.0f - ys[i]) * canvas.height());
+ *
+ * Optionally, the analysis can run on its own thread via startAnalysisThread. processAnalyzer
+ * then only picks up the newest finished frame, so heavy FFTs never stall the draw callback and
+ * the analysis keeps running while nothing is being drawn.
  */
 class AnalyzerProcessor {
   public:
     struct Band {
-        std::vector<int> bins = {};  ///< FFT bin indices that belong to this band
-        float dB = -100.f;           ///< Current amplitude of the band in dB FS
+        std::ranges::iota_view<int, int> bins; ///< FFT bin indices that belong to this band
+        float dB = -100.f;                     ///< Current amplitude of the band in dB FS
+        float x = 0.0f;                        ///< Normalized x position, as in spectrumLine
     };
 
+    static constexpr int k_max_channels = 8;
+
     AnalyzerProcessor();
+    ~AnalyzerProcessor();
 
     /**
      * @brief Returns the current spectrum line data for visualization.
@@ -65,28 +89,131 @@ class AnalyzerProcessor {
      * value is above the maximum dB.
      *
      * If line smoothing is enabled (via setLineSmoothingInterpolationSteps), then the line will
-     * have more (interpolated) points, and it will be smoother and less jagged.
+     * have more (interpolated) points, and it will be smoother and less jagged. With a line
+     * resolution set, the level of detail gets matched to the display, see setLineResolution.
+     *
+     * This interleaves the x and y values of xs() and ys() and is only kept for compatibility.
+     * The points get assembled on the first call after a new frame came in, always from the
+     * first channel.
      *
      * @return Vector of points representing the spectrum.
      */
     const std::vector<tb::Point>& spectrumLine() const;
 
+    /**
+     * @brief The x values of the spectrum line, as described in spectrumLine.
+     *
+     * These only change on reconfiguration, see xsVersion. Stays valid until the next call to
+     * processAnalyzer, setEngine, setLineResolution or reset.
+     */
+    std::span<const float> xs() const noexcept;
+
+    /**
+     * @brief The y values of a channel's spectrum line, as described in spectrumLine, one per x
+     * value. All channels share the same x values.
+     *
+     * Stays valid until the next call to processAnalyzer, setEngine, setLineResolution or reset.
+     */
+    std::span<const float> ys(int channel = 0) const noexcept;
+
+    /** The number of channels of the current frame, i.e. how many spectra ys and bands hold */
+    int numChannels() const noexcept;
+
+    /**
+     * @brief A number that only changes when the x values change, so that consumers can hold on
+     * to their own copy of xs() and only take over the y values for each new frame.
+     */
+    uint64_t xsVersion() const noexcept;
+
+    /**
+     * @brief Matches the line's level of detail to a display that is `num_columns` pixels wide
+     * and shows the x values from `min_x` to `max_x`, so that the cost of the line scales with
+     * the display rather than with the band count or the zoom.
+     *
+     * Only the bands in view make it into the line, plus one on each side so that it reaches the
+     * edges. Where several bands fall into a column, they first get reduced to their minimum &
+     * maximum, so that peaks are kept. Interpolation then gives each gap between two points only
+     * as many steps as the columns it spans, so there are about as many points as columns,
+     * whatever the band count. 0 columns, the default, turns this off and covers the full range.
+     *
+     * The new line gets laid out without holding up the analysis. Call this on the same thread as
+     * processAnalyzer & setEngine.
+     */
+    void setLineResolution(int num_columns, float min_x = 0.0f, float max_x = 1.0f);
+
+    int lineResolution() const noexcept { return line_columns_.load(std::memory_order_relaxed); }
+
     /**
      * @brief Access the frequency bands data.
      *
      * This could be useful in case you may want to display extra information, like the peak dB
      * values for each band.
      *
-     * @return Vector of Band objects. Note that this vector may have a different size than the
-     * target number of bands set via setTargetNumBands.
+     * @return A lightweight random access view of a channel's Band values, which are assembled
+     * on the fly from the internal flat band layout. Note that this may have a different size than
+     * the target number of bands set via setTargetNumBands.
+     *
+     * The view refers to the current frame, so like xs() and ys() it stays valid until the next
+     * call to processAnalyzer, setEngine, setLineResolution or reset. Copy the values out to keep
+     * them for longer.
      */
-    const std::vector<Band>& bands() const noexcept { return bands_; }
+    auto bands(int channel = 0) const {
+        // The layout comes from the engine that produced the frame, so the two always match up
+        const auto& frame = frames_.readBuffer();
+        const auto num_bands = frame.engine->band_x.size();
+        const auto* band_dB = frame.band_dB.data() + static_cast<size_t>(channel) * num_bands;
+        return std::views::iota(size_t { 0 }, num_bands) |
+               std::views::transform([&frame, band_dB](size_t i) {
+                   const auto& engine = *frame.engine;
+                   return Band { .bins = std::views::iota(engine.band_bin_offsets[i], engine.band_bin_offsets[i + 1]),
+                                 .dB = band_dB[i],
+                                 .x = engine.band_x[i] };
+               });
+    }
+
+    struct TransferBand {
+        float magnitude_dB = 0.0f; ///< Gain from the reference (last) channel to the first one
+        float phase = 0.0f;        ///< Phase of the gain in radians, in [-pi, pi]
+        float coherence = 0.0f;    ///< Magnitude-squared coherence in [0, 1]. Low values mean the gain can't be trusted.
+        float x = 0.0f;            ///< Normalized x position, as in spectrumLine
+    };
+
+    /**
+     * @brief Access the transfer function per band, if NonRealtimeParameters::transfer_function is
+     * set. Empty otherwise.
+     *
+     * The first channel is taken as the output of the system under test and the last channel as
+     * its input, e.g. the signal sent to a speaker & a measurement mic in front of it. The gain is
+     * H = Sxy / Sxx, with the auto & cross spectra averaged over FFT frames as in Welch's method
+     * (see NonRealtimeParameters::transfer_averages). The magnitude & coherence are computed per
+     * bin and averaged over each band's bins, weighted by the reference power, so that a delay
+     * between the channels doesn't lower them. The phase is that of the band's summed Sxy, which
+     * is only meaningful if the phase doesn't turn much within a band, i.e. for short delays.
+     *
+     * DC & the bins below the frequency range are left out, as in bands(). Bands without any
+     * other bins, e.g. the lowest band at small FFT sizes, or without any reference signal read
+     * as the minimum dB, with a coherence of 0.
+     *
+     * @return A lightweight random access view of TransferBand values, one per band. Stays valid
+     * for as long as the view returned by bands() does.
+     */
+    auto transferFunction() const {
+        const auto& frame = frames_.readBuffer();
+        return std::views::iota(size_t { 0 }, frame.transfer_dB.size()) |
+               std::views::transform([&frame](size_t i) {
+                   return TransferBand { .magnitude_dB = frame.transfer_dB[i],
+                                         .phase = frame.transfer_phase[i],
+                                         .coherence = frame.transfer_coherence[i],
+                                         .x = frame.engine->band_x[i] };
+               });
+    }
 
     // ---------------------------------------------------------------------------------------------
     // "Non-realtime" parameters
     //
     // Changing these parameters requires a more hefty internal update, with buffers & the band
-    // vector being resized. There will be a brief pause / reset in the analyzer display.
+    // vector being rebuilt. This happens off to the side while the audio thread carries on, and
+    // the current band levels get carried over onto the new bands.
     // ---------------------------------------------------------------------------------------------
     struct NonRealtimeParameters {
         double sample_rate               = 44'100.0;
@@ -98,9 +225,160 @@ class AnalyzerProcessor {
         float weighting_center_frequency = 1'000.0f;
         int line_interpolation_steps     = 4;
         tb::WindowType window_type       = tb::WindowType::BlackmanHarris;
+        float overlap                    = 0.75f; ///< Fraction of each FFT window shared with the next one, e.g. 0.5, 0.75, 0.875
+        bool exact_log                   = false; ///< Use std::log10 for the dB conversion rather than the fast approximation
+        int num_channels                 = 1;     ///< Number of channels to analyze, up to k_max_channels
+        bool transfer_function           = false; ///< Measure the transfer function, needs at least 2 channels, see transferFunction
+        int transfer_averages            = 16;    ///< Number of FFT frames the transfer function gets averaged over
+        int channel_routing              = 0;     ///< Not used by the analyzer. Tells a processAudio mix function what the channels hold, see processAudio.
+
+        bool operator==(const NonRealtimeParameters&) const = default;
+    };
+
+    /**
+     * Everything that depends on the non-realtime parameters: FFT plan, window, sample ring, band
+     * layout and the analysis state that goes with it. Reconfiguring builds a whole new engine
+     * off to the side and swaps it in, see prepareEngine & setEngine.
+     *
+     * Treat this as opaque, it is only public so that engines can be built on another thread.
+     *
+     * Per channel buffers hold one run per channel, back to back, e.g. band_dB holds
+     * `num_channels * band_x.size()` levels.
+     */
+    /** What the line is laid out for, see setLineResolution */
+    struct LineResolution {
+        int num_columns = 0;
+        float min_x = 0.0f;
+        float max_x = 1.0f;
+
+        bool operator==(const LineResolution&) const = default;
     };
 
+    struct Engine {
+        NonRealtimeParameters params;
+        int hop_size = 1;
+
+        std::unique_ptr<SampleRing> sample_ring;
+        uint64_t reset_position = 0; ///< Audio written before this ring position is treated as silence
+        uint64_t next_hop_end = 0;   ///< Ring position at which the next FFT window ends
+        uint64_t last_write_position = 0; ///< Ring write position at the previous analysis, to tell if audio is flowing
+        uint64_t ballistics_position = 0; ///< Ring position up to which the band levels have been moved towards their targets
+        double seconds_without_audio = 0.0;
+
+        std::shared_ptr<const SharedWindow> window;
+        std::vector<float> fft_in; ///< Per channel
+        std::unique_ptr<FftPlan> fft;
+        std::vector<std::complex<float>> fft_output; ///< Per channel
+        std::vector<float> bin_power_weights;
+
+        // Flat band layout. The bins of band i are [band_bin_offsets[i], band_bin_offsets[i + 1]).
+        std::vector<int> band_bin_offsets;
+        std::vector<float> band_x;
+        std::vector<float> band_dB;        ///< Per channel
+        std::vector<float> band_target_dB; ///< Per channel, the levels of the latest hop that band_dB moves towards
+        std::vector<float> band_power;     ///< Per channel, scratch space for the per hop band reduction
+
+        // Level of detail, see setLineResolution. The line is made of the bands [line_first_band,
+        // line_last_band). When columns hold more than 2 bands, the bands of group i are
+        // [line_group_offsets[i], line_group_offsets[i + 1]) of those and get reduced before any
+        // interpolation. Otherwise the offsets are empty and the bands are used as they are.
+        LineResolution line_resolution;
+        size_t line_first_band = 0;
+        size_t line_last_band = 0;
+        std::vector<int> line_group_offsets;
+        std::vector<float> band_y; ///< Scratch space for one channel's normalized levels before the reduction
+
+        // Spline control points when smoothing: the (reduced) bands plus 2 extra points on each end
+        std::vector<float> control_x;
+        std::vector<float> control_y; ///< Per channel
+
+        // With a line resolution, each segment gets its own number of steps, so each point has its
+        // own first control point & 4 weights, see kernels::catmullRomPoints. Otherwise these are
+        // empty & all segments get line_steps steps.
+        int line_steps = 0; ///< The most interpolation steps any segment gets, at most line_interpolation_steps
+        std::vector<float> spline_basis; ///< Catmull-Rom weights per interpolation step, see kernels::catmullRom
+        std::vector<int> line_segments;
+        std::vector<float> line_weights;
+
+        // The line that gets published. The x values only depend on the band layout, so they are
+        // computed once here and only the y values get updated per frame.
+        std::vector<float> line_x;
+        std::vector<float> line_y; ///< Per channel
+        uint64_t line_x_version = 0; ///< Assigned by setEngine, see xsVersion
+
+        // Transfer function, see transferFunction. The auto & cross spectra are running averages
+        // per bin, which get reduced per band once per analysis.
+        int num_cross_frames = 0; ///< Frames averaged so far, capped at transfer_averages
+        std::vector<float> cross_xx;
+        std::vector<float> cross_yy;
+        std::vector<std::complex<float>> cross_xy;
+        std::vector<float> transfer_dB;
+        std::vector<float> transfer_phase;
+        std::vector<float> transfer_coherence;
+
+        // What the last published frame was made from, to tell if a new one is needed
+        std::vector<float> published_dB; ///< Per channel
+        float published_min_dB = std::numeric_limits<float>::quiet_NaN();
+        float published_max_dB = std::numeric_limits<float>::quiet_NaN();
+    };
+
+    /**
+     * @brief Builds and swaps in a new engine for the given parameters, i.e.
+     * `setEngine(prepareEngine(params))`.
+     */
     void setNonRealtimeParameters(NonRealtimeParameters params);
+
+    /**
+     * @brief Builds a new engine for the given parameters: FFT plan, window, calibration, band
+     * layout, etc. This is the expensive part of reconfiguring.
+     *
+     * Doesn't touch the analyzer's current state, so it is safe to call from any thread, e.g. a
+     * background task. Hand the result over with setEngine.
+     */
+    std::shared_ptr<Engine> prepareEngine(const NonRealtimeParameters& params) const;
+
+    /**
+     * @brief Swaps in an engine built by prepareEngine. This is cheap, the audio thread switches
+     * over without ever blocking.
+     *
+     * The current band levels get resampled onto the new bands by log frequency, so the display
+     * and its ballistics carry on rather than dropping to the minimum dB. Channels the current
+     * engine doesn't have start at the minimum dB.
+     *
+     * Call this on the same thread as processAnalyzer.
+     */
+    void setEngine(std::shared_ptr<Engine> engine);
+
+    /**
+     * @brief Takes a recently used engine for the given parameters out of the engine cache, or
+     * returns nullptr if there is none.
+     *
+     * Engines that got swapped out are kept around, so that flipping back to a recent
+     * configuration is just a setEngine rather than a whole new build. setNonRealtimeParameters
+     * checks here first.
+     *
+     * Call this on the same thread as processAnalyzer.
+     */
+    std::shared_ptr<Engine> takeCachedEngine(const NonRealtimeParameters& params);
+
+    static constexpr size_t k_default_engine_cache_capacity = 4;
+
+    /** Caps how many swapped out engines get kept around, 0 turning the cache off. */
+    void setEngineCacheCapacity(size_t capacity);
+
+    struct EngineCacheStats {
+        size_t size     = 0;
+        size_t capacity = 0;
+        uint64_t hits   = 0; ///< takeCachedEngine calls that found an engine
+        uint64_t misses = 0; ///< takeCachedEngine calls that didn't
+
+        double hitRate() const noexcept {
+            return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        }
+    };
+
+    EngineCacheStats engineCacheStats() const noexcept;
+
     const NonRealtimeParameters& nonRealtimeParameters() const noexcept { return non_realtime_params_; }
 
     // ---------------------------------------------------------------------------------------------
@@ -129,15 +407,39 @@ class AnalyzerProcessor {
     /**
      * @brief Processes incoming audio data for analysis.
      *
-     * Call this on the real-time audio thread. This call is real-time safe unless a
-     * "non-real-time" parameter is changed. See the implementation comments for details.
+     * Call this on the real-time audio thread, from one thread at a time. This call is wait-free
+     * and keeps all audio while "non-real-time" parameters are being changed, as long as the
+     * channel count stays the same.
      *
-     * @param audio Audio buffer to analyze.
+     * The channel count needs to match the NonRealtimeParameters::num_channels of the engine in
+     * use, blocks with any other count get ignored. Since a new engine only gets used once it's
+     * built, changing the channel count this way drops audio for as long as the build takes. Use
+     * the overload taking a mix function to avoid that.
      *
-     * @note Currently, only a channel count of 1 is supported.
+     * @param audio Audio buffer to analyze.
      */
     void processAudio(choc::buffer::ChannelArrayView<float> audio);
 
+    /**
+     * @brief Processes incoming audio data for analysis, as mixed for the engine in use.
+     *
+     * `mix` gets called with the NonRealtimeParameters of the engine the audio is about to go
+     * to, and returns a ChannelArrayView<float> with its num_channels channels. Mixing for those
+     * parameters (e.g. going by channel_routing) rather than the latest ones means that changing
+     * the channel count never drops any audio: the old mix carries on until the new engine is in.
+     *
+     * Same real-time guarantees as processAudio(audio), provided `mix` is real-time safe as well.
+     */
+    template <typename MixFunction>
+        requires std::invocable<MixFunction&, const NonRealtimeParameters&>
+    void processAudio(MixFunction&& mix) {
+        // See processAudio(audio) for the epoch
+        audio_epoch_.fetch_add(1);
+        auto* engine = audio_engine_.load();
+        writeAudio(*engine, mix(std::as_const(engine->params)));
+        audio_epoch_.fetch_add(1, std::memory_order_release);
+    }
+
     /**
      * @brief Processes incoming audio data for analysis using raw buffer pointers.
      *
@@ -149,30 +451,105 @@ class AnalyzerProcessor {
      *                    an array of float samples for a single channel.
      * @param channels Number of audio channels in the input (size of audioBuffers array).
      * @param frames Number of audio frames (samples per channel) in each buffer.
-     *
-     * @note Currently, only a channel count of 1 is supported.
      */
     void processAudio(float** audio_buffers, int channels, int frames);
 
     /**
      * @brief Updates spectrum analysis with time-based parameters.
      *
-     * Call this on your graphics drawing callback. The analyzer will pull the latest FFT
-     * data from the audio thread and process the band magnitudes, ballistics, smoothing, etc.
+     * Call this on your graphics drawing callback. The analyzer will run an FFT for every hop of
+     * audio that arrived since the last call (see NonRealtimeParameters::overlap), in order, and
+     * process the band magnitudes, ballistics, smoothing, etc. Ballistics advance in audio time
+     * towards the levels of the latest hop, also in between hops, so large FFT sizes with long hops
+     * still move smoothly. Called once per hop or more rarely, the result doesn't depend on how
+     * often this gets called.
+     *
+     * If audio stops coming in, e.g. because the host stopped processing, no FFTs are run and
+     * after a short while the band levels just keep falling at the release rate.
+     *
+     * If the analysis thread is running, this only picks up the newest frame it has finished.
+     *
+     * Call this, spectrumLine, bands, reset and setNonRealtimeParameters all from the same thread.
      *
      * @param delta_time_seconds Time since the last processAnalyzer call in seconds.
+     * @return True if a new frame was picked up, i.e. spectrumLine and bands changed and need to
+     * be redrawn. New frames only get made if something visibly changed, see isConverged.
+     */
+    bool processAnalyzer(double delta_time_seconds);
+
+    /**
+     * @brief True if the latest analysis didn't change any band by a visible amount since the
+     * last frame, e.g. because the input is silent and all bands have settled. No new frames get
+     * made while converged.
+     */
+    bool isConverged() const noexcept { return converged_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Starts running the analysis on a dedicated thread at a fixed rate.
+     *
+     * Finished frames get handed over through a lock-free triple buffer and picked up by
+     * processAnalyzer. Calling this while the thread is already running restarts it.
+     *
+     * @param rate_hz Number of analysis frames per second, see setAnalysisRate.
      */
-    void processAnalyzer(double delta_time_seconds);
+    void startAnalysisThread(double rate_hz);
+
+    /** Changes the rate of the analysis thread, taking effect with its next frame. */
+    void setAnalysisRate(double rate_hz);
+    double analysisRate() const noexcept { return analysis_rate_hz_.load(std::memory_order_relaxed); }
 
     /**
-     * @brief Resets the analyzer state. Band dB values will get reset to the minimum dB value.
+     * @brief The share of one CPU core that the analysis has been taking up recently, averaged
+     * over about a second. E.g. 0.01 means the analysis keeps a core busy 1% of the time.
+     */
+    float analysisLoad() const noexcept { return analysis_load_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Stops the analysis thread, if it is running. processAnalyzer goes back to running
+     * the analysis itself.
+     */
+    void stopAnalysisThread();
+
+    bool isAnalysisThreadRunning() const noexcept { return analysis_thread_.joinable(); }
+
+    /**
+     * @brief Resets the analyzer state. Band dB values will get reset to the minimum dB value and
+     * any audio received so far will be ignored.
      */
     void reset();
 
   private:
-    void updateBands();
+    /** A finished analysis result, as handed over to the consumer thread */
+    struct Frame {
+        std::shared_ptr<const Engine> engine; ///< Keeps the band layout alive for bands()
+        std::vector<float> band_dB; ///< Per channel, as in Engine
+        std::vector<float> line_y;  ///< Per channel, as in Engine
+        std::vector<float> transfer_dB;
+        std::vector<float> transfer_phase;
+        std::vector<float> transfer_coherence;
+    };
 
-    using RealtimeObject = farbot::RealtimeObject<std::vector<float>, farbot::RealtimeObjectOptions::realtimeMutatable>;
+    /** An engine that was swapped out, but might still be in use by the audio thread */
+    struct RetiredEngine {
+        std::shared_ptr<Engine> engine;
+        uint64_t audio_epoch = 0; ///< audio_epoch_ right after the engine got swapped out
+    };
+
+    static void writeAudio(Engine& engine, choc::buffer::ChannelArrayView<float> audio);
+    void collectRetiredEngines();
+    void cacheEngine(std::shared_ptr<Engine> engine);
+    void analyze(std::unique_lock<std::mutex>& lock, double delta_time_seconds);
+    void runAnalysis(std::unique_lock<std::mutex>& lock, double delta_time_seconds);
+    void processHop(Engine& engine, uint64_t end_position);
+    void publishFrame();
+    bool updateFrame();
+    void resetState();
+
+    LineResolution requestedLineResolution() const noexcept {
+        return { .num_columns = line_columns_.load(std::memory_order_relaxed),
+                 .min_x = line_min_x_.load(std::memory_order_relaxed),
+                 .max_x = line_max_x_.load(std::memory_order_relaxed) };
+    }
 
     NonRealtimeParameters non_realtime_params_;
 
@@ -182,19 +559,43 @@ class AnalyzerProcessor {
     std::atomic<float> min_dB_  = k_default_min_dB;
     std::atomic<float> max_dB_  = k_default_max_dB;
 
-    std::unique_ptr<tb::FifoBuffer<float>> fifo_buffer_;
+    std::atomic<bool> converged_ = false;
+
+    // The audio thread's view of the current engine. It never owns the engine, which is instead
+    // kept alive by analysis_engine_ and, once swapped out, by retired_engines_ until the audio
+    // thread is known to be done with it. The epoch is odd while processAudio is running.
+    std::atomic<Engine*> audio_engine_ = nullptr;
+    std::atomic<uint64_t> audio_epoch_ = 0;
+    std::vector<RetiredEngine> retired_engines_;
+
+    // Swapped out engines that the audio thread is done with, most recently used first
+    std::vector<std::shared_ptr<Engine>> engine_cache_;
+    size_t engine_cache_capacity_ = k_default_engine_cache_capacity;
+    uint64_t engine_cache_hits_ = 0;
+    uint64_t engine_cache_misses_ = 0;
+
+    // Guards the analysis engine & the producer side of frames_ against the analysis thread
+    std::mutex analysis_mutex_;
+    std::condition_variable analysis_cv_;
+    bool stop_analysis_thread_ = false;
+    std::atomic<double> analysis_rate_hz_ = 60.0;
+    std::atomic<float> analysis_load_ = 0.0f;
+    std::thread analysis_thread_;
+    std::shared_ptr<Engine> analysis_engine_;
+
+    TripleBuffer<Frame> frames_;
+    bool frame_picked_up_elsewhere_ = false; ///< A new frame was picked up outside of processAnalyzer
+    uint64_t line_x_version_ = 0;
 
-    std::mutex mutex_;
-    std::unique_ptr<RealtimeObject> transfer_buffer_;
+    // The requested line resolution, which engines built on other threads get laid out for. If it
+    // changes in the middle of a build, setEngine lays the line out again.
+    std::atomic<int> line_columns_ = 0;
+    std::atomic<float> line_min_x_ = 0.0f;
+    std::atomic<float> line_max_x_ = 1.0f;
 
-    std::vector<float> window_;
-    choc::buffer::ChannelArrayBuffer<float> fft_in_buffer_;
-    std::unique_ptr<FastFourier> fft_;
-    std::vector<std::complex<float>> fft_output_;
-    std::vector<float> bin_weights_;
-    std::vector<Band> bands_;
-    std::vector<tb::Point> bands_line_;
-    std::vector<tb::Point> smoothed_line_;
+    // spectrumLine's interleaved copy of the current frame's line
+    mutable std::vector<tb::Point> spectrum_line_;
+    mutable bool spectrum_line_stale_ = true;
 
   public:
     // Prevent copying & moving
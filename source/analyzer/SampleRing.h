@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * @class SampleRing
+ * @brief Wait-free single-producer / single-consumer ring buffer of audio samples, for one or
+ * more channels.
+ *
+ * The producer (audio thread) writes only the new samples of each block and then publishes a
+ * running write position. The consumer (analysis side) can copy out any run of samples that
+ * hasn't been overwritten yet, usually the latest FFT window. The producer never copies more
+ * than the incoming block, so its cost scales with the block size instead of the window size.
+ *
+ * All channels share a single write position, so they always get published together.
+ *
+ * Positions are absolute sample counts since construction and never wrap in practice.
+ */
+class SampleRing {
+  public:
+    /**
+     * @param min_capacity Minimum number of samples the ring must hold. This gets rounded up to
+     * the next power of 2. Leave some headroom over the largest read size so that the producer
+     * can keep writing while the consumer is copying.
+     * @param num_channels Number of channels, each with its own run of samples.
+     */
+    explicit SampleRing(int min_capacity, int num_channels = 1) :
+        capacity_(std::bit_ceil(static_cast<uint32_t>(std::max(min_capacity, 1)))),
+        num_channels_(std::max(num_channels, 1)),
+        buffer_(capacity_ * num_channels_),
+        mask_(capacity_ - 1) { }
+
+    int capacity() const noexcept { return static_cast<int>(capacity_); }
+    int numChannels() const noexcept { return static_cast<int>(num_channels_); }
+
+    /**
+     * @brief Appends samples to the ring and publishes the new write position.
+     *
+     * Producer side only. Wait-free. `channels` needs to hold one pointer per channel. If more
+     * samples than the capacity are passed, only the most recent ones are kept.
+     */
+    void write(const float* const* channels, int num_samples) noexcept {
+        auto position = write_position_.load(std::memory_order_relaxed);
+
+        // Only the tail of an oversized block would survive anyway
+        size_t offset = 0;
+        if (num_samples > capacity()) {
+            offset = static_cast<size_t>(num_samples - capacity());
+            position += offset;
+            num_samples = capacity();
+        }
+
+        // Announce which slots are about to be overwritten before touching them, so that a
+        // concurrent read can tell if it got torn (seqlock style)
+        const auto end = position + num_samples;
+        reserve_position_.store(end, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const auto start = static_cast<size_t>(position & mask_);
+        const auto first = std::min(static_cast<size_t>(num_samples), capacity_ - start);
+        for (size_t channel = 0; channel < num_channels_; ++channel) {
+            const auto* samples = channels[channel] + offset;
+            auto* buffer = buffer_.data() + channel * capacity_;
+            std::memcpy(buffer + start, samples, first * sizeof(float));
+            std::memcpy(buffer, samples + first, (num_samples - first) * sizeof(float));
+        }
+
+        write_position_.store(end, std::memory_order_release);
+    }
+
+    /** Mono version of write, for rings with a single channel */
+    void write(const float* samples, int num_samples) noexcept { write(&samples, num_samples); }
+
+    /**
+     * @brief The position one past the last published sample.
+     */
+    uint64_t writePosition() const noexcept { return write_position_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Copies the `num_samples` samples of a channel that end at `end_position` into `dest`.
+     *
+     * Consumer side only. `end_position` must not be past writePosition(). Samples before the
+     * start of the stream are read as silence.
+     *
+     * @return False if the producer overwrote part of the requested range while (or before) it
+     * was being copied, in which case the contents of `dest` are unreliable.
+     */
+    bool read(float* dest, int num_samples, uint64_t end_position, int channel = 0) const noexcept {
+        if (num_samples > capacity())
+            return false;
+
+        // Zero-fill whatever lies before the beginning of the stream
+        const auto count = static_cast<size_t>(std::min<uint64_t>(end_position, num_samples));
+        const auto num_silent = num_samples - static_cast<int>(count);
+        std::fill_n(dest, num_silent, 0.0f);
+
+        const auto position = end_position - count;
+        const auto start = static_cast<size_t>(position & mask_);
+        const auto first = std::min(count, capacity_ - start);
+        const auto* buffer = buffer_.data() + static_cast<size_t>(channel) * capacity_;
+        std::memcpy(dest + num_silent, buffer + start, first * sizeof(float));
+        std::memcpy(dest + num_silent + first, buffer, (count - first) * sizeof(float));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return reserve_position_.load(std::memory_order_relaxed) <= position + capacity_;
+    }
+
+  private:
+    const size_t capacity_;
+    const size_t num_channels_;
+    std::vector<float> buffer_; ///< One run of capacity_ samples per channel
+    const uint64_t mask_;
+
+    std::atomic<uint64_t> write_position_ = 0;
+    std::atomic<uint64_t> reserve_position_ = 0;
+
+  public:
+    // Prevent copying & moving
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+};
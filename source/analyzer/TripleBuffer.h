@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+/**
+ * @class TripleBuffer
+ * @brief Lock-free single-producer / single-consumer triple buffer.
+ *
+ * The producer fills writeBuffer() and calls publish(). The consumer calls update() to grab the
+ * newest published buffer, which then stays stable in readBuffer() until the next update(). Older
+ * unread buffers are simply dropped, so neither side ever waits on the other.
+ */
+template <typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer() = default;
+
+    /** Producer side. The buffer to fill in before calling publish(). */
+    T& writeBuffer() noexcept { return buffers_[write_index_]; }
+
+    /** Producer side. Hands the write buffer over to the consumer. */
+    void publish() noexcept {
+        write_index_ = middle_.exchange(write_index_ | k_fresh_bit, std::memory_order_acq_rel) & k_index_mask;
+    }
+
+    /**
+     * @brief Consumer side. Swaps in the newest published buffer, if there is one.
+     * @return True if readBuffer() now refers to a buffer that wasn't seen before.
+     */
+    bool update() noexcept {
+        if ((middle_.load(std::memory_order_relaxed) & k_fresh_bit) == 0)
+            return false;
+
+        read_index_ = middle_.exchange(read_index_, std::memory_order_acq_rel) & k_index_mask;
+        return true;
+    }
+
+    /** Consumer side. The most recently acquired buffer. */
+    const T& readBuffer() const noexcept { return buffers_[read_index_]; }
+
+    /**
+     * @brief Applies a function to all three buffers, e.g. to resize them.
+     *
+     * Only call this while neither the producer nor the consumer is active.
+     */
+    template <typename F>
+    void forEach(F&& f) {
+        for (auto& b : buffers_)
+            f(b);
+    }
+
+  private:
+    static constexpr int k_fresh_bit = 0b100;
+    static constexpr int k_index_mask = 0b011;
+
+    std::array<T, 3> buffers_ = {};
+    int write_index_ = 0;
+    int read_index_ = 1;
+    std::atomic<int> middle_ = 2;
+
+  public:
+    // Prevent copying & moving
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <numbers>
+
+/**
+ * Which channels of the input get analyzed. Each analyzed channel is drawn as its own trace.
+ *
+ * The modes up to MidSide work on any layout, folded down to left & right first. The ones after
+ * pick individual channels out of a surround layout, see isAvailable.
+ */
+enum class ChannelMode {
+    MonoSum,
+    Left,
+    Right,
+    LeftRight,
+    Mid,
+    Side,
+    MidSide,
+    Center,
+    Lfe,
+    Surrounds,   ///< The side pair of 7.1.4, or the back pair of 5.1
+    Rears,       ///< The back pair of 7.1.4
+    TopFront,    ///< The front height pair of 7.1.4
+    TopRear,     ///< The back height pair of 7.1.4
+};
+
+/** The input port layouts on offer, see SpectrumPlugin::audioPortsGetConfig */
+enum class InputLayout { Mono, Stereo, Surround51, Surround714, Ambisonic1, Ambisonic3 };
+
+/** The sidechain input is always stereo, and gets analyzed as a mono sum */
+inline constexpr int k_num_sidechain_channels = 2;
+
+/**
+ * Gains that turn the input channels into the analyzed ones, one row of input gains per analyzed
+ * channel. Applied on the audio thread by kernels::mixChannels.
+ */
+struct ChannelMatrix {
+    static constexpr int k_max_inputs = 16 + k_num_sidechain_channels;
+    static constexpr int k_max_outputs = 3;
+
+    int num_inputs = 2;
+    int num_outputs = 1;
+    std::array<float, k_max_inputs * k_max_outputs> gains {}; ///< Row major, gains[output * num_inputs + input]
+};
+
+/**
+ * The channel mode & whether the sidechain reference comes along, packed into a single int to
+ * travel with the analyzer's engine, see AnalyzerProcessor::NonRealtimeParameters::channel_routing.
+ */
+struct ChannelRouting {
+    ChannelMode mode = ChannelMode::MonoSum;
+    bool with_sidechain = false;
+
+    constexpr int pack() const { return static_cast<int>(mode) * 2 + (with_sidechain ? 1 : 0); }
+
+    static constexpr ChannelRouting unpack(int packed) {
+        return { .mode = static_cast<ChannelMode>(packed / 2), .with_sidechain = packed % 2 != 0 };
+    }
+};
+
+/** The number of analyzed channels, with the sidechain reference (if any) coming last */
+constexpr int numAnalyzedChannels(ChannelMode mode, bool with_sidechain = false) {
+    const auto is_pair = mode == ChannelMode::LeftRight || mode == ChannelMode::MidSide ||
+                         mode == ChannelMode::Surrounds || mode == ChannelMode::Rears ||
+                         mode == ChannelMode::TopFront || mode == ChannelMode::TopRear;
+    return (is_pair ? 2 : 1) + (with_sidechain ? 1 : 0);
+}
+
+constexpr int numInputChannels(InputLayout layout) {
+    switch (layout) {
+        case InputLayout::Mono:        return 1;
+        case InputLayout::Stereo:      return 2;
+        case InputLayout::Surround51:  return 6;
+        case InputLayout::Surround714: return 12;
+        case InputLayout::Ambisonic1:  return 4;
+        case InputLayout::Ambisonic3:  return 16;
+    }
+
+    return 2;
+}
+
+/** Left & right input gains per analyzed channel, i.e. a 2 by 2 matrix when both rows are used */
+constexpr std::array<float, 4> stereoModeGains(ChannelMode mode) {
+    // Mid is the same (L + R) / 2 as the mono sum, so that a centered signal reads the same level
+    // in every mode. Side is (L - R) / 2 to match.
+    switch (mode) {
+        case ChannelMode::MonoSum:   return { 0.5f, 0.5f };
+        case ChannelMode::Left:      return { 1.0f, 0.0f };
+        case ChannelMode::Right:     return { 0.0f, 1.0f };
+        case ChannelMode::LeftRight: return { 1.0f, 0.0f, 0.0f, 1.0f };
+        case ChannelMode::Mid:       return { 0.5f, 0.5f };
+        case ChannelMode::Side:      return { 0.5f, -0.5f };
+        case ChannelMode::MidSide:   return { 0.5f, 0.5f, 0.5f, -0.5f };
+        default:                     return {};
+    }
+
+    return {};
+}
+
+/**
+ * The input channels the selection modes pick out, one per analyzed channel, in the channel
+ * orders listed in stereoFoldDown. -1 where the layout doesn't have the channel, or for the modes
+ * that fold down instead.
+ */
+constexpr std::array<int, 2> selectedChannels(ChannelMode mode, InputLayout layout) {
+    const auto is_51 = layout == InputLayout::Surround51;
+    const auto is_714 = layout == InputLayout::Surround714;
+    if (! is_51 && ! is_714)
+        return { -1, -1 };
+
+    switch (mode) {
+        case ChannelMode::Center:    return { 2, -1 };
+        case ChannelMode::Lfe:       return { 3, -1 };
+        case ChannelMode::Surrounds: return is_51 ? std::array { 4, 5 } : std::array { 6, 7 };
+        case ChannelMode::Rears:     return is_714 ? std::array { 4, 5 } : std::array { -1, -1 };
+        case ChannelMode::TopFront:  return is_714 ? std::array { 8, 9 } : std::array { -1, -1 };
+        case ChannelMode::TopRear:   return is_714 ? std::array { 10, 11 } : std::array { -1, -1 };
+        default:                     return { -1, -1 };
+    }
+}
+
+constexpr bool isSelectionMode(ChannelMode mode) { return mode >= ChannelMode::Center; }
+
+/**
+ * Whether a mode makes sense for a layout. The selection modes need a layout with the channels
+ * they pick, any others work everywhere. An unavailable mode still works, its traces stay silent.
+ */
+constexpr bool isAvailable(ChannelMode mode, InputLayout layout) {
+    return ! isSelectionMode(mode) || selectedChannels(mode, layout)[0] >= 0;
+}
+
+/** Gains that fold a layout down to left & right, one row per side */
+struct StereoFoldDown {
+    std::array<float, ChannelMatrix::k_max_inputs> left {};
+    std::array<float, ChannelMatrix::k_max_inputs> right {};
+};
+
+constexpr StereoFoldDown stereoFoldDown(InputLayout layout) {
+    constexpr auto g = std::numbers::sqrt2_v<float> / 2.0f;
+
+    switch (layout) {
+        case InputLayout::Mono:
+            return { { 1.0f }, { 1.0f } };
+
+        case InputLayout::Stereo:
+            return { { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+
+        // FL FR FC LFE BL BR. The usual Lo/Ro fold down, with the LFE left out. The Lfe mode shows
+        // it on its own.
+        case InputLayout::Surround51:
+            return { { 1.0f, 0.0f, g, 0.0f, g, 0.0f }, { 0.0f, 1.0f, g, 0.0f, 0.0f, g } };
+
+        // FL FR FC LFE BL BR SL SR TFL TFR TBL TBR. The sides & heights fold onto their own side.
+        case InputLayout::Surround714:
+            return { { 1.0f, 0.0f, g, 0.0f, g, 0.0f, g, 0.0f, g, 0.0f, g, 0.0f },
+                     { 0.0f, 1.0f, g, 0.0f, 0.0f, g, 0.0f, g, 0.0f, g, 0.0f, g } };
+
+        // ACN ordering, SN3D normalization: W Y Z X ... A pair of virtual cardioids facing left
+        // & right, which only needs W & Y. The higher orders don't get read at all.
+        case InputLayout::Ambisonic1:
+        case InputLayout::Ambisonic3:
+            return { { 0.5f, 0.5f }, { 0.5f, -0.5f } };
+    }
+
+    return {};
+}
+
+/**
+ * The full matrix from the layout's channels to the analyzed ones: the layout gets folded down to
+ * left & right, followed by the channel mode. Both are linear, so they collapse into one matrix
+ * and the audio thread only makes a single pass over the input.
+ *
+ * With the sidechain, its channels follow the main input's and its mono sum gets added as the
+ * last analyzed channel.
+ */
+constexpr ChannelMatrix channelMatrix(ChannelMode mode, InputLayout layout, bool with_sidechain = false) {
+    const auto mode_gains = stereoModeGains(mode);
+    const auto fold_down = stereoFoldDown(layout);
+    const auto num_main_inputs = numInputChannels(layout);
+    const auto num_main_outputs = numAnalyzedChannels(mode);
+
+    ChannelMatrix matrix;
+    matrix.num_inputs = num_main_inputs + (with_sidechain ? k_num_sidechain_channels : 0);
+    matrix.num_outputs = numAnalyzedChannels(mode, with_sidechain);
+    if (isSelectionMode(mode)) {
+        const auto selected = selectedChannels(mode, layout);
+        for (int output = 0; output < num_main_outputs; ++output) {
+            if (selected[output] >= 0)
+                matrix.gains[output * matrix.num_inputs + selected[output]] = 1.0f;
+        }
+    } else {
+        for (int output = 0; output < num_main_outputs; ++output) {
+            for (int input = 0; input < num_main_inputs; ++input) {
+                matrix.gains[output * matrix.num_inputs + input] = mode_gains[output * 2] * fold_down.left[input] +
+                                                                  mode_gains[output * 2 + 1] * fold_down.right[input];
+            }
+        }
+    }
+
+    if (with_sidechain) {
+        auto* row = matrix.gains.data() + num_main_outputs * matrix.num_inputs;
+        for (int input = num_main_inputs; input < matrix.num_inputs; ++input)
+            row[input] = 1.0f / k_num_sidechain_channels;
+    }
+
+    return matrix;
+}
@@ -3,11 +3,59 @@
 
 #include "ui/MainFrame.h"
 
+#include <algorithm>
+#include <array>
+#include <span>
 #include <tb_Core.h>
 #include <clap/helpers/plugin.hxx>
 
+#include "AnalyzerKernels.h"
+
+namespace {
+
+struct PortLayout {
+    InputLayout layout;
+    const char* name;
+    const char* port_type;
+};
+
+// The configurations on offer through the audio ports config extension. Each config's id is its
+// index, and the same layout is used for the input & the output.
+constexpr std::array k_port_layouts {
+    PortLayout { InputLayout::Mono, "Mono", CLAP_PORT_MONO },
+    PortLayout { InputLayout::Stereo, "Stereo", CLAP_PORT_STEREO },
+    PortLayout { InputLayout::Surround51, "5.1", CLAP_PORT_SURROUND },
+    PortLayout { InputLayout::Surround714, "7.1.4", CLAP_PORT_SURROUND },
+    PortLayout { InputLayout::Ambisonic1, "Ambisonic 1st order", CLAP_PORT_AMBISONIC },
+    PortLayout { InputLayout::Ambisonic3, "Ambisonic 3rd order", CLAP_PORT_AMBISONIC },
+};
+
+const PortLayout& portLayout(InputLayout layout) {
+    return *std::ranges::find(k_port_layouts, layout, &PortLayout::layout);
+}
+
+// Channel maps of the surround layouts, in the order stereoFoldDown expects them
+constexpr std::array<uint8_t, 6> k_surround_51_map { CLAP_SURROUND_FL, CLAP_SURROUND_FR, CLAP_SURROUND_FC,
+                                                     CLAP_SURROUND_LFE, CLAP_SURROUND_BL, CLAP_SURROUND_BR };
+constexpr std::array<uint8_t, 12> k_surround_714_map { CLAP_SURROUND_FL,  CLAP_SURROUND_FR,  CLAP_SURROUND_FC,
+                                                       CLAP_SURROUND_LFE, CLAP_SURROUND_BL,  CLAP_SURROUND_BR,
+                                                       CLAP_SURROUND_SL,  CLAP_SURROUND_SR,  CLAP_SURROUND_TFL,
+                                                       CLAP_SURROUND_TFR, CLAP_SURROUND_TBL, CLAP_SURROUND_TBR };
+
+template <size_t N>
+constexpr uint64_t channelMask(const std::array<uint8_t, N>& map) {
+    uint64_t mask = 0;
+    for (const auto position : map)
+        mask |= uint64_t { 1 } << position;
+
+    return mask;
+}
+
+}
+
 const clap_plugin_descriptor* SpectrumPlugin::getDescriptor() {
-    static const char* features[] = { CLAP_PLUGIN_FEATURE_STEREO, CLAP_PLUGIN_FEATURE_ANALYZER,
+    static const char* features[] = { CLAP_PLUGIN_FEATURE_STEREO, CLAP_PLUGIN_FEATURE_SURROUND,
+                                      CLAP_PLUGIN_FEATURE_AMBISONIC, CLAP_PLUGIN_FEATURE_ANALYZER,
                                       "Free and Open Source", nullptr };
 
     static clap_plugin_descriptor desc = { CLAP_VERSION,
@@ -36,12 +84,17 @@ void SpectrumPlugin::onPosixFd(int fd, clap_posix_fd_flags_t flags) noexcept {
 #endif
 
 bool SpectrumPlugin::activate(double sampleRate, uint32_t /*minFrames*/, uint32_t maxFrames) noexcept {
-    stereo_mix_buffer_.resize({.numChannels = 1, .numFrames = maxFrames});
+    mix_buffer_.resize({.numChannels = ChannelMatrix::k_max_outputs, .numFrames = maxFrames});
     state_.setSampleRate(sampleRate);
+
+    // Keep the analysis off the GUI thread, and running even while the editor is closed
+    analyzer_processor_.startAnalysisThread(state_.frameRate());
     return true;
 }
 
-void SpectrumPlugin::deactivate() noexcept { }
+void SpectrumPlugin::deactivate() noexcept {
+    analyzer_processor_.stopAnalysisThread();
+}
 
 void SpectrumPlugin::reset() noexcept { }
 
@@ -49,20 +102,43 @@ clap_process_status SpectrumPlugin::process(const clap_process* process) noexcep
     auto in = cb::createChannelArrayView(process->audio_inputs->data32,
                                          process->audio_inputs->channel_count, process->frames_count);
 
-    if (in.getNumChannels() != 2) {
-        tb_assert(false); // Unsupported channel count
+    if (in.getNumChannels() != static_cast<uint32_t>(numInputChannels(input_layout_))) {
+        tb_assert(false); // Doesn't match the selected port configuration
         return CLAP_PROCESS_ERROR;
     }
 
-    {
-        // Average the two input channels into a single buffer to be processed
-        tb_assert(stereo_mix_buffer_.getNumFrames() >= in.getNumFrames());
-        auto mix = stereo_mix_buffer_.getStart(in.getNumFrames());
-        copy(mix, in.getChannel(0));
-        add(mix, in.getChannel(1));
-        applyGain(mix, 0.5f);
-        analyzer_processor_.processAudio(mix);
-    }
+    // Fold down, select & matrix the input channels into the analyzed ones, all in a single pass.
+    // Channels with no say in the result (e.g. the LFE or higher order ambisonics) don't even get
+    // read, so a wide bus costs little more than a stereo one. The routing comes from the engine
+    // the audio goes to rather than from the state, so that the old routing carries on while the
+    // engine for a new one gets built.
+    analyzer_processor_.processAudio([&](const AnalyzerProcessor::NonRealtimeParameters& params) {
+        tb_assert(mix_buffer_.getNumFrames() >= in.getNumFrames());
+        const auto routing = ChannelRouting::unpack(params.channel_routing);
+        const auto with_sidechain = routing.with_sidechain;
+        auto matrix = channelMatrix(routing.mode, input_layout_, with_sidechain);
+        tb_assert(matrix.num_outputs == params.num_channels);
+
+        // The sidechain's channels follow the main input's, and get analyzed in the same batch
+        std::array<const float*, ChannelMatrix::k_max_inputs> inputs {};
+        std::copy_n(process->audio_inputs[0].data32, in.getNumChannels(), inputs.begin());
+        if (with_sidechain) {
+            const auto* sidechain = process->audio_inputs_count > 1 ? &process->audio_inputs[1] : nullptr;
+            if (sidechain != nullptr && sidechain->channel_count == k_num_sidechain_channels) {
+                std::copy_n(sidechain->data32, k_num_sidechain_channels, inputs.begin() + in.getNumChannels());
+            } else {
+                // Not connected, so the reference reads as silence. Zero gains never get read.
+                auto* row = matrix.gains.data() + (matrix.num_outputs - 1) * matrix.num_inputs;
+                std::fill_n(row, matrix.num_inputs, 0.0f);
+            }
+        }
+
+        auto mix = mix_buffer_.getView().getChannelRange({ 0, static_cast<cb::ChannelCount>(matrix.num_outputs) })
+                                        .getStart(in.getNumFrames());
+        kernels::mixChannels(inputs.data(), matrix.num_inputs, mix.data.channels, matrix.num_outputs,
+                             matrix.gains.data(), static_cast<int>(in.getNumFrames()));
+        return mix;
+    });
 
     // Hosts are allowed to out-of-place process even if we set `in_place_pair` in the port handling
     if (process->audio_inputs->data32 != process->audio_outputs->data32) {
@@ -75,18 +151,99 @@ clap_process_status SpectrumPlugin::process(const clap_process* process) noexcep
     return CLAP_PROCESS_CONTINUE;
 }
 
-bool SpectrumPlugin::audioPortsInfo(uint32_t index, bool /*isInput*/,
+bool SpectrumPlugin::audioPortsInfo(uint32_t index, bool isInput,
                                     clap_audio_port_info* info) const noexcept {
+    if (isInput && index == 1) {
+        strncpy(info->name, "Sidechain", sizeof(info->name));
+        info->id = 1;
+        info->flags = 0;
+        info->channel_count = k_num_sidechain_channels;
+        info->in_place_pair = CLAP_INVALID_ID;
+        info->port_type = CLAP_PORT_STEREO;
+        return true;
+    }
+
     if (index != 0)
         return false;
 
     strncpy(info->name, "Main Input", sizeof(info->name));
     info->id = 0;
     info->flags = CLAP_AUDIO_PORT_IS_MAIN;
-    info->channel_count = 2;
+    info->channel_count = static_cast<uint32_t>(numInputChannels(input_layout_));
     info->in_place_pair = 0;
-    info->port_type = CLAP_PORT_STEREO;
+    info->port_type = portLayout(input_layout_).port_type;
+
+    return true;
+}
+
+uint32_t SpectrumPlugin::audioPortsConfigCount() const noexcept {
+    return static_cast<uint32_t>(k_port_layouts.size());
+}
+
+bool SpectrumPlugin::audioPortsGetConfig(uint32_t index, clap_audio_ports_config* config) const noexcept {
+    if (index >= k_port_layouts.size())
+        return false;
+
+    const auto& port_layout = k_port_layouts[index];
+    const auto num_channels = static_cast<uint32_t>(numInputChannels(port_layout.layout));
+
+    config->id = index;
+    strncpy(config->name, port_layout.name, sizeof(config->name));
+    config->input_port_count = 2; // Including the sidechain
+    config->output_port_count = 1;
+    config->has_main_input = true;
+    config->main_input_channel_count = num_channels;
+    config->main_input_port_type = port_layout.port_type;
+    config->has_main_output = true;
+    config->main_output_channel_count = num_channels;
+    config->main_output_port_type = port_layout.port_type;
+
+    return true;
+}
+
+bool SpectrumPlugin::audioPortsSetConfig(clap_id config_id) noexcept {
+    // Hosts may only switch configurations while we're deactivated
+    if (isActive() || config_id >= k_port_layouts.size())
+        return false;
+
+    input_layout_ = k_port_layouts[config_id].layout;
+    state_.setInputLayout(input_layout_);
+    return true;
+}
+
+bool SpectrumPlugin::surroundIsChannelMaskSupported(uint64_t channel_mask) const noexcept {
+    return channel_mask == channelMask(k_surround_51_map) || channel_mask == channelMask(k_surround_714_map);
+}
+
+uint32_t SpectrumPlugin::surroundGetChannelMap(bool /*is_input*/, uint32_t port_index, uint8_t* channel_map,
+                                               uint32_t channel_map_capacity) const noexcept {
+    if (port_index != 0)
+        return 0;
+
+    std::span<const uint8_t> map;
+    if (input_layout_ == InputLayout::Surround51)
+        map = k_surround_51_map;
+    else if (input_layout_ == InputLayout::Surround714)
+        map = k_surround_714_map;
+
+    const auto count = std::min(static_cast<uint32_t>(map.size()), channel_map_capacity);
+    std::copy_n(map.begin(), count, channel_map);
+    return count;
+}
+
+bool SpectrumPlugin::ambisonicIsConfigSupported(const clap_ambisonic_config* config) const noexcept {
+    // stereoFoldDown assumes ACN ordering & SN3D normalization
+    return config->ordering == CLAP_AMBISONIC_ORDERING_ACN &&
+           config->normalization == CLAP_AMBISONIC_NORMALIZATION_SN3D;
+}
+
+bool SpectrumPlugin::ambisonicGetConfig(bool /*is_input*/, uint32_t port_index,
+                                        clap_ambisonic_config* config) const noexcept {
+    if (port_index != 0 || (input_layout_ != InputLayout::Ambisonic1 && input_layout_ != InputLayout::Ambisonic3))
+        return false;
 
+    config->ordering = CLAP_AMBISONIC_ORDERING_ACN;
+    config->normalization = CLAP_AMBISONIC_NORMALIZATION_SN3D;
     return true;
 }
 
@@ -8,6 +8,7 @@
 #include "common/Common.h"
 
 #include "AnalyzerProcessor.h"
+#include "ChannelMatrix.h"
 #include "State.h"
 
 #if NDEBUG
@@ -39,10 +40,25 @@ class SpectrumPlugin : public ClapPlugin {
 
     bool implementsAudioPorts() const noexcept override { return true; }
 
-    uint32_t audioPortsCount(bool /*isInput*/) const noexcept override { return 1; }
+    // The main input & output, plus the sidechain input
+    uint32_t audioPortsCount(bool isInput) const noexcept override { return isInput ? 2 : 1; }
 
     bool audioPortsInfo(uint32_t index, bool isInput, clap_audio_port_info* info) const noexcept override;
 
+    bool implementsAudioPortsConfig() const noexcept override { return true; }
+    uint32_t audioPortsConfigCount() const noexcept override;
+    bool audioPortsGetConfig(uint32_t index, clap_audio_ports_config* config) const noexcept override;
+    bool audioPortsSetConfig(clap_id config_id) noexcept override;
+
+    bool implementsSurround() const noexcept override { return true; }
+    bool surroundIsChannelMaskSupported(uint64_t channel_mask) const noexcept override;
+    uint32_t surroundGetChannelMap(bool is_input, uint32_t port_index, uint8_t* channel_map,
+                                   uint32_t channel_map_capacity) const noexcept override;
+
+    bool implementsAmbisonic() const noexcept override { return true; }
+    bool ambisonicIsConfigSupported(const clap_ambisonic_config* config) const noexcept override;
+    bool ambisonicGetConfig(bool is_input, uint32_t port_index, clap_ambisonic_config* config) const noexcept override;
+
     bool implementsState() const noexcept override { return true; }
     bool stateSave(const clap_ostream* stream) noexcept override;
     bool stateLoad(const clap_istream* stream) noexcept override;
@@ -66,10 +82,14 @@ class SpectrumPlugin : public ClapPlugin {
     int pluginWidth() const;
     int pluginHeight() const;
 
+    // Declared ahead of the state, which may still be building an engine for it on destruction
+    AnalyzerProcessor analyzer_processor_;
     State state_;
 
-    choc::buffer::ChannelArrayBuffer<float> stereo_mix_buffer_;
-    AnalyzerProcessor analyzer_processor_;
+    choc::buffer::ChannelArrayBuffer<float> mix_buffer_; ///< The analyzed channels, see ChannelMode
+
+    // Only ever changes while deactivated, so the audio thread can read it as is
+    InputLayout input_layout_ = InputLayout::Stereo;
 
     std::unique_ptr<ApplicationWindow> gui_window_;
     bool notify_host_of_resize_ = true;
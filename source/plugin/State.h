@@ -2,7 +2,9 @@
 #pragma once
 
 #include <tb_Math.h>
+#include <chrono>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <magic_enum/magic_enum.hpp>
 #include <map>
@@ -11,6 +13,7 @@
 #include <utility>
 
 #include "common/Common.h"
+#include "ChannelMatrix.h"
 
 class State {
 public:
@@ -25,7 +28,17 @@ public:
     };
 
     State(AnalyzerProcessor& p, std::function<void()> notify_host_handler) :
-        analyzer_processor_(p), notify_host_handler_(std::move(notify_host_handler)) { }
+        analyzer_processor_(p), notify_host_handler_(std::move(notify_host_handler)) {
+        governor_timer_.onTimerCallback() = [this] { updateGovernor(); };
+        governor_timer_.startTimer(k_governor_interval_ms);
+    }
+
+    /**
+     * Steps the governor takes to reduce the analysis load, in order. The FFTs run once per hop,
+     * whatever the frame rate, so they usually dominate and the hop size goes up first. The
+     * per frame work (line & drawing) comes next, the band count matters least.
+     */
+    enum class QualityReduction { None, LessOverlap, LowerFrameRate, NoCurve, FewerBands };
 
     void setSampleRate(double sample_rate) {
         tb_assert(sample_rate > 0.0);
@@ -90,6 +103,109 @@ public:
 
     tb::WindowType window_type() const noexcept { return non_realtime_params_.window_type; }
 
+    void setOverlap(float overlap) {
+        overlap = std::clamp(overlap, 0.0f, 0.875f);
+        non_realtime_params_.overlap = overlap;
+        stateChanged();
+        asyncUpdateAnalyzer();
+    }
+
+    float overlap() const noexcept { return non_realtime_params_.overlap; }
+
+    void setChannelMode(ChannelMode mode) {
+        channel_mode_ = mode;
+        updateChannelRouting();
+        stateChanged();
+        asyncUpdateAnalyzer();
+    }
+
+    ChannelMode channel_mode() const noexcept { return channel_mode_; }
+
+    /** The layout of the main input, which decides what channel modes are on offer */
+    void setInputLayout(InputLayout layout) {
+        if (layout == input_layout_)
+            return;
+
+        input_layout_ = layout;
+
+        // Only the UI needs to know, the host owns the layout
+        notifyListeners();
+    }
+
+    InputLayout input_layout() const noexcept { return input_layout_; }
+
+    /** Shows the sidechain input as a reference trace, analyzed alongside the main input */
+    void setSidechainEnabled(bool enabled) {
+        sidechain_enabled_ = enabled;
+        updateChannelRouting();
+        non_realtime_params_.transfer_function = enabled && non_realtime_params_.transfer_function;
+        stateChanged();
+        asyncUpdateAnalyzer();
+    }
+
+    bool sidechain_enabled() const noexcept { return sidechain_enabled_; }
+
+    /**
+     * Measures the transfer function from the sidechain to the main input. Needs the sidechain,
+     * so turning this on turns it on too.
+     */
+    void setTransferFunctionEnabled(bool enabled) {
+        if (enabled && ! sidechain_enabled())
+            setSidechainEnabled(true);
+
+        non_realtime_params_.transfer_function = enabled;
+        stateChanged();
+        asyncUpdateAnalyzer();
+    }
+
+    bool transfer_function_enabled() const noexcept { return non_realtime_params_.transfer_function; }
+
+    void setFrameRateCap(int frame_rate_cap) {
+        frame_rate_cap_ = std::max(frame_rate_cap, 0);
+        stateChanged();
+        analyzer_processor_.setAnalysisRate(frameRate());
+    }
+
+    /** 0 means uncapped */
+    int frame_rate_cap() const noexcept { return frame_rate_cap_; }
+
+    /** The rate the analysis & drawing actually run at, after the governor had its say */
+    double frameRate() const noexcept {
+        auto rate = frame_rate_cap_ > 0 ? static_cast<double>(frame_rate_cap_) : k_max_frame_rate;
+        if (quality_reduction_ >= QualityReduction::LowerFrameRate)
+            rate /= 2.0;
+
+        return rate;
+    }
+
+    void setGovernorEnabled(bool enabled) {
+        governor_enabled_ = enabled;
+        stateChanged();
+
+        if (! enabled)
+            setQualityReduction(QualityReduction::None);
+    }
+
+    bool governor_enabled() const noexcept { return governor_enabled_; }
+
+    QualityReduction quality_reduction() const noexcept { return quality_reduction_; }
+
+    /** The non-realtime parameters the analyzer actually runs with, after the governor had its say */
+    AnalyzerProcessor::NonRealtimeParameters analyzerParameters() const {
+        auto p = non_realtime_params_;
+        // Halves the number of hops, e.g. 75% overlap becomes 50%
+        if (quality_reduction_ >= QualityReduction::LessOverlap)
+            p.overlap = std::max(0.0f, 1.0f - 2.0f * (1.0f - p.overlap));
+
+        if (quality_reduction_ >= QualityReduction::NoCurve)
+            p.line_interpolation_steps = 0;
+
+        if (quality_reduction_ >= QualityReduction::FewerBands)
+            p.target_num_bands = std::max(5, p.target_num_bands / 2);
+
+        return p;
+    }
+
     void setMinDb(float min_dB) {
         min_dB = std::clamp(min_dB, -125.0f, -40.0f);
         analyzer_processor_.setMinDb(min_dB);
@@ -129,6 +245,34 @@ public:
 
     bool hide_controls() const noexcept { return hide_controls_; }
 
+    /**
+     * @brief Sets the visible frequency range, for zooming & panning.
+     *
+     * The analyzer always covers k_min_frequency to k_max_frequency, so this only moves a viewport
+     * over the bands it already has and never touches the analysis.
+     */
+    void setViewFrequencyRange(float min_freq, float max_freq) {
+        tb_assert(min_freq > 0.0f && max_freq > 0.0f);
+
+        // Keep at least an octave in view, and the view within the analyzed range
+        const auto min_log = std::log2(k_min_frequency);
+        const auto max_log = std::log2(k_max_frequency);
+        const auto span = std::clamp(std::log2(max_freq / min_freq), k_min_view_octaves, max_log - min_log);
+        const auto view_min_log = std::clamp(std::log2(min_freq), min_log, max_log - span);
+        view_min_frequency_ = std::exp2(view_min_log);
+        view_max_frequency_ = std::exp2(view_min_log + span);
+
+        // Only the UI needs to know, it's not a change to the saved state
+        notifyListeners();
+    }
+
+    float view_min_frequency() const noexcept { return view_min_frequency_; }
+    float view_max_frequency() const noexcept { return view_max_frequency_; }
+
+    bool isZoomed() const noexcept {
+        return view_min_frequency_ > k_min_frequency || view_max_frequency_ < k_max_frequency;
+    }
+
     bool loadFromJson(const std::string& json_state) {
         try {
             nlohmann::json j = nlohmann::json::parse(json_state);
@@ -149,6 +293,16 @@ public:
                 if (windowType.has_value())
                     setWindowType(windowType.value());
 
+                // Added after the initial release, so older states won't have it
+                setOverlap(j.value("overlap", AnalyzerProcessor::NonRealtimeParameters().overlap));
+                setFrameRateCap(j.value("frame_rate_cap", k_default_frame_rate_cap));
+                setGovernorEnabled(j.value("governor", true));
+
+                const auto channel_mode = magic_enum::enum_cast<ChannelMode>(j.value("channel_mode", std::string()));
+                setChannelMode(channel_mode.value_or(ChannelMode::MonoSum));
+                setSidechainEnabled(j.value("sidechain", false));
+                setTransferFunctionEnabled(j.value("transfer_function", false));
+
                 setAttackRate(j["attack"].get<float>());
                 setReleaseRate(j["release"].get<float>());
                 setMinDb(j["min_db"].get<float>());
@@ -175,6 +329,12 @@ public:
         j["weighting_center_frequency"] = weighting_center_frequency();
         j["line_smoothing_factor"] = line_smoothing_interpolation_steps();
         j["window_type"] = std::string(magic_enum::enum_name(window_type()));
+        j["overlap"] = overlap();
+        j["frame_rate_cap"] = frame_rate_cap();
+        j["governor"] = governor_enabled();
+        j["channel_mode"] = std::string(magic_enum::enum_name(channel_mode()));
+        j["sidechain"] = sidechain_enabled();
+        j["transfer_function"] = transfer_function_enabled();
         j["attack"] = attack_rate();
         j["release"] = release_rate();
         j["min_db"] = min_dB();
@@ -199,10 +359,15 @@ public:
         non_realtime_params_.sample_rate = sample_rate;
         non_realtime_params_.min_frequency = k_min_frequency;
         non_realtime_params_.max_frequency = k_max_frequency;
+        channel_mode_ = ChannelMode::MonoSum;
+        sidechain_enabled_ = false;
+        updateChannelRouting();
         setAttackRate(AnalyzerProcessor::k_default_attack);
         setReleaseRate(AnalyzerProcessor::k_default_release);
         setMinDb(AnalyzerProcessor::k_default_min_dB);
         setMaxDb(AnalyzerProcessor::k_default_max_dB);
+        setFrameRateCap(k_default_frame_rate_cap);
+        setGovernorEnabled(true);
         stateChanged();
         syncAnalyzer();
     }
@@ -212,24 +377,108 @@ private:
         if (! notify_listeners_)
             return;
 
-        for (auto& listenerCallback : callbacks_ | std::views::values)
-            listenerCallback();
+        notifyListeners();
 
         if (notify_host_handler_)
             notify_host_handler_();
     }
 
+    void notifyListeners() {
+        for (auto& listenerCallback : callbacks_ | std::views::values)
+            listenerCallback();
+    }
+
+    void updateGovernor() {
+        if (! governor_enabled_)
+            return;
+
+        // Give the load average time to settle after each step, so that we don't overshoot
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_quality_change_ < std::chrono::milliseconds(k_governor_settle_ms))
+            return;
+
+        // Each step roughly halves some part of the work, so only step back up once there's
+        // plenty of headroom, or we'd end up going back and forth
+        const auto load = analyzer_processor_.analysisLoad();
+        const auto level = static_cast<int>(quality_reduction_);
+        if (load > k_analysis_load_budget && quality_reduction_ != k_max_quality_reduction)
+            setQualityReduction(static_cast<QualityReduction>(level + 1));
+        else if (load < k_analysis_load_budget * 0.35f && quality_reduction_ != QualityReduction::None)
+            setQualityReduction(static_cast<QualityReduction>(level - 1));
+    }
+
+    void setQualityReduction(QualityReduction reduction) {
+        if (reduction == quality_reduction_)
+            return;
+
+        quality_reduction_ = reduction;
+        last_quality_change_ = std::chrono::steady_clock::now();
+
+        asyncUpdateAnalyzer();
+        analyzer_processor_.setAnalysisRate(frameRate());
+
+        // Only the UI needs to know, it's not a change to the saved state
+        notifyListeners();
+    }
+
+    void updateChannelRouting() {
+        // The audio thread mixes for whatever the engine in use was built with, so the routing
+        // only changes along with the channel count once the new engine is in
+        const auto routing = ChannelRouting { .mode = channel_mode_, .with_sidechain = sidechain_enabled_ };
+        non_realtime_params_.num_channels = numAnalyzedChannels(routing.mode, routing.with_sidechain);
+        non_realtime_params_.channel_routing = routing.pack();
+    }
+
     void syncAnalyzer() {
-        analyzer_processor_.setNonRealtimeParameters(non_realtime_params_);
-        timer_.stopTimer();
+        // Any engine still being built in the background is outdated now, and gets dropped by
+        // pollEngineBuild once it's done
+        analyzer_processor_.setNonRealtimeParameters(analyzerParameters());
     }
 
     void asyncUpdateAnalyzer() {
+        // With a build already in flight, pollEngineBuild starts the next one as soon as it's
+        // done. This way a slider drag only ever has one build running and always ends up on
+        // the latest parameters.
+        if (! engine_build_.valid())
+            startEngineBuild();
+    }
+
+    void startEngineBuild() {
+        // Switching back to a recently used configuration doesn't need a build at all
+        if (auto engine = analyzer_processor_.takeCachedEngine(analyzerParameters())) {
+            analyzer_processor_.setEngine(std::move(engine));
+            return;
+        }
+
+        // FFT plans, windows & band layouts can take a noticeable while to build at large FFT
+        // sizes, so do it on a background task rather than stalling the host's UI
+        engine_build_ = std::async(std::launch::async, [&analyzer = analyzer_processor_, params = analyzerParameters()] {
+            return analyzer.prepareEngine(params);
+        });
+
+        timer_.onTimerCallback() = [this] { pollEngineBuild(); };
+        timer_.startTimer(k_engine_build_poll_ms);
+    }
+
+    void pollEngineBuild() {
+        if (engine_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        auto engine = engine_build_.get();
         timer_.stopTimer();
-        timer_.onTimerCallback() = [this] { syncAnalyzer(); };
-        timer_.startTimer(120);
+
+        if (engine->params == analyzerParameters())
+            analyzer_processor_.setEngine(std::move(engine));
+        else if (analyzer_processor_.nonRealtimeParameters() != analyzerParameters())
+            startEngineBuild(); // The parameters changed again while we were building
     }
 
+    static constexpr int k_engine_build_poll_ms = 10;
+    static constexpr int k_governor_interval_ms = 500;
+    static constexpr int k_governor_settle_ms = 2'000;
+    static constexpr auto k_max_quality_reduction = QualityReduction::FewerBands;
+    static constexpr float k_min_view_octaves = 1.0f;
+
     AnalyzerProcessor& analyzer_processor_;
 
     bool notify_listeners_ = true;
@@ -238,5 +487,18 @@ private:
 
     AnalyzerProcessor::NonRealtimeParameters non_realtime_params_;
     bool hide_controls_ = false;
+    ChannelMode channel_mode_ = ChannelMode::MonoSum;
+    bool sidechain_enabled_ = false;
+    InputLayout input_layout_ = InputLayout::Stereo;
+    float view_min_frequency_ = k_min_frequency;
+    float view_max_frequency_ = k_max_frequency;
+    int frame_rate_cap_ = k_default_frame_rate_cap;
+
+    bool governor_enabled_ = true;
+    QualityReduction quality_reduction_ = QualityReduction::None;
+    std::chrono::steady_clock::time_point last_quality_change_;
+    EventTimer governor_timer_;
+
+    std::future<std::shared_ptr<AnalyzerProcessor::Engine>> engine_build_;
     EventTimer timer_;
 };
\ No newline at end of file
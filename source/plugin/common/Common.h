@@ -10,6 +10,15 @@ static constexpr uint32_t k_max_width = 4'000;
 static constexpr uint32_t k_min_height = 80;
 static constexpr uint32_t k_max_height = 3'000;
 
+// Frame rate cap for the analysis & drawing, 0 meaning uncapped
+static constexpr int k_default_frame_rate_cap = 60;
+
+// What uncapped boils down to, as there's no point in going faster than any display
+static constexpr double k_max_frame_rate = 240.0;
+
+// Share of a CPU core each instance's analysis may take up before the governor reduces quality
+static constexpr float k_analysis_load_budget = 0.02f;
+
 static constexpr uint32_t k_default_width = 630;
 static constexpr uint32_t k_default_height = 1'010;
 
@@ -1,53 +1,240 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
 #include "AnalyzerProcessor.h"
 
 #include "common/Common.h"
+#include "common/Palette.h"
 
 class AnalyzerFrame : public Frame {
   public:
+    /**
+     * The most analyzed channels that get drawn, each as its own trace: up to 2 for the main input
+     * (see ChannelMode), plus the sidechain reference
+     */
+    static constexpr int k_max_traces = 3;
+
     AnalyzerFrame(AnalyzerProcessor& p) : analyzer_processor_(p) {
         setIgnoresMouseEvents(true, true);
+
+        // The lines & their fills get drawn on the GPU by visage's line shaders, so there's no path
+        // to build and tessellate per frame. All that's left to do here is to hand over the points.
+        // One line per analyzed channel, the later ones on top.
+        for (auto& line : lines_) {
+            addChild(line, false);
+            line.setIgnoresMouseEvents(true, true);
+            line.setFill(true);
+            line.setFillCenter(GraphLine::kBottom);
+        }
+
+        lines_[1].setPaletteOverride(spectrum::SecondTrace);
+        lines_[k_reference_line].setPaletteOverride(spectrum::ReferenceTrace);
+
+        // The transfer function goes on top of the spectra, hidden until it's turned on
+        for (auto* line : { &coherence_line_, &transfer_line_ }) {
+            addChild(*line, false);
+            line->setIgnoresMouseEvents(true, true);
+            line->setVisible(false);
+        }
+
+        transfer_line_.setPaletteOverride(spectrum::TransferTrace);
+        coherence_line_.setPaletteOverride(spectrum::CoherenceTrace);
+
+        // Rather than redrawing at the full frame rate forever, poll the analyzer and only
+        // redraw when it has something new to show. A silent track settles and then costs next
+        // to nothing.
+        timer_.onTimerCallback() = [this] { pollAnalyzer(); };
+        setFrameRate(k_default_frame_rate_cap);
     }
 
-    void draw(Canvas& canvas) override {
-        analyzer_processor_.processAnalyzer(canvas.deltaTime());
+    /** Caps how often the analyzer gets redrawn */
+    void setFrameRate(double frame_rate) {
+        // Polling at twice the frame rate keeps the added latency below half a frame. At high
+        // frame rates that would mean a timer every couple of ms, so the polling is capped there.
+        const auto interval_ms = std::max(k_min_poll_interval_ms, static_cast<int>(1'000.0 / frame_rate / 2.0));
+        if (interval_ms == timer_interval_ms_)
+            return;
 
-        const auto& line = analyzer_processor_.spectrumLine();
+        timer_interval_ms_ = interval_ms;
+        timer_.startTimer(interval_ms);
+    }
 
-        Path path;
+    /**
+     * Shows the part of the line between the given x values, e.g. 0.25 to 0.5 shows the second
+     * quarter of the analyzer's frequency range across the full width.
+     */
+    void setViewRange(float min_x, float max_x) {
+        tb_assert(min_x < max_x);
+        if (min_x == view_min_x_ && max_x == view_max_x_)
+            return;
+
+        view_min_x_ = min_x;
+        view_max_x_ = max_x;
+        updateLayout();
+    }
 
-        const auto line_thickness = 2;
+    /** Draws the last analyzed channel as the sidechain reference, rather than the main input */
+    void setShowsReference(bool shows_reference) {
+        if (shows_reference == shows_reference_)
+            return;
 
-        path.moveTo(0, height());
-        for (const auto i : line)
-            path.lineTo(i.x * width(), (1 - i.y)  * height() + (line_thickness + 1));
+        shows_reference_ = shows_reference;
+        line_x_version_ = 0;
+        updateLine();
+    }
 
-        path.lineTo(width(), height());
+    /**
+     * Draws the transfer function from the sidechain to the main input on top of the spectra, see
+     * AnalyzerProcessor::transferFunction
+     */
+    void setShowsTransferFunction(bool shows_transfer_function) {
+        if (shows_transfer_function == shows_transfer_function_)
+            return;
+
+        shows_transfer_function_ = shows_transfer_function;
+        transfer_line_.setVisible(shows_transfer_function);
+        coherence_line_.setVisible(shows_transfer_function);
+        line_x_version_ = 0;
+        updateLine();
+    }
 
-        // Blue
-        const auto fill_color = Color(0x358BDB).withAlpha(0.62);
-        const auto line_color = Color(0x63AFF2).withAlpha(1.0);
+    void resized() override {
+        for (auto& line : lines_)
+            line.setBounds(localBounds());
 
-        const auto fade_out_start = 0.54f * height();
-        const auto x = width() / 2;
+        transfer_line_.setBounds(localBounds());
+        coherence_line_.setBounds(localBounds());
 
-        canvas.setColor(GraphLine::LineFillColor);
-        canvas.setBrush(Brush::linear(Gradient(fill_color, fill_color.withAlpha(0)),
-                                                { x, fade_out_start }, { x, height() }));
-        canvas.fill(path);
+        updateLayout();
+    }
 
-        canvas.setColor(GraphLine::LineColor);
-        canvas.setBrush(Brush::linear(Gradient(line_color, line_color.withAlpha(0)),
-                                                { x, fade_out_start }, { x, height() }));
-        canvas.fill(path.stroke(line_thickness));
+  private:
+    void pollAnalyzer() {
+        const auto now = std::chrono::steady_clock::now();
+        const auto delta_time = std::chrono::duration<double>(now - last_poll_time_).count();
+        last_poll_time_ = now;
 
-        redraw();
+        if (analyzer_processor_.processAnalyzer(delta_time))
+            updateLine();
     }
 
-  private:
+    void updateLayout() {
+        // Only compute as much line as there are physical pixels to show it on, and only for the
+        // part of the frequency range in view, so zooming in costs nothing extra
+        const auto line_width = static_cast<int>(std::ceil(width() * dpiScale()));
+        analyzer_processor_.setLineResolution(line_width, view_min_x_, view_max_x_);
+
+        // The pixel x positions depend on the width & view
+        line_x_version_ = 0;
+        updateLine();
+    }
+
+    // The line that draws an analyzed channel. The reference always gets its own line, so that it
+    // keeps its colors whatever the channel mode.
+    GraphLine& lineFor(int channel, int num_channels) {
+        if (shows_reference_ && num_channels > 1 && channel == num_channels - 1)
+            return lines_[k_reference_line];
+
+        return lines_[channel];
+    }
+
+    void updateLine() {
+        const auto xs = analyzer_processor_.xs();
+        const auto num_traces = std::min(analyzer_processor_.numChannels(), k_max_traces);
+
+        // The x values only change on reconfiguration, so most frames only touch the y values
+        const auto version = analyzer_processor_.xsVersion();
+        const auto layout_changed = version != line_x_version_ || num_traces != num_traces_;
+        if (layout_changed) {
+            line_x_version_ = version;
+            num_traces_ = num_traces;
+
+            for (auto& line : lines_)
+                line.setVisible(false);
+
+            const auto scale = width() / (view_max_x_ - view_min_x_);
+            for (int trace = 0; trace < num_traces; ++trace) {
+                auto& line = lineFor(trace, num_traces);
+                line.setVisible(true);
+                line.setNumPoints(static_cast<int>(xs.size()));
+                for (size_t i = 0; i < xs.size(); ++i)
+                    line.setXAt(static_cast<int>(i), (xs[i] - view_min_x_) * scale);
+            }
+        }
+
+        // Shifted down so that the line sits on the bottom edge at the minimum dB. Hoisted out of
+        // the loop, so that it's a straight copy with a multiply-add per point.
+        const auto h = static_cast<float>(height());
+        const auto y_offset = h + static_cast<float>(k_line_thickness + 1);
+        for (int trace = 0; trace < num_traces; ++trace) {
+            auto& line = lineFor(trace, num_traces);
+            const auto ys = analyzer_processor_.ys(trace);
+            const auto num_points = static_cast<int>(ys.size());
+            for (int i = 0; i < num_points; ++i)
+                line.setYAt(i, y_offset - ys[i] * h);
+
+            line.redraw();
+        }
+
+        if (shows_transfer_function_)
+            updateTransferFunction(layout_changed);
+    }
+
+    // One point per band rather than the smoothed line, as there are no more than a few hundred
+    // bands. The magnitude is centered on 0 dB, the coherence spans the full height.
+    // The band x values change along with the line's, so they only get set with the line's.
+    void updateTransferFunction(bool layout_changed) {
+        const auto transfer = analyzer_processor_.transferFunction();
+        const auto num_points = static_cast<int>(transfer.size());
+        if (layout_changed || num_points != num_transfer_points_) {
+            num_transfer_points_ = num_points;
+            transfer_line_.setNumPoints(num_points);
+            coherence_line_.setNumPoints(num_points);
+
+            const auto scale = width() / (view_max_x_ - view_min_x_);
+            for (int i = 0; i < num_points; ++i) {
+                const auto x = (transfer[i].x - view_min_x_) * scale;
+                transfer_line_.setXAt(i, x);
+                coherence_line_.setXAt(i, x);
+            }
+        }
+
+        const auto h = static_cast<float>(height());
+        for (int i = 0; i < num_points; ++i) {
+            const auto band = transfer[i];
+            const auto magnitude = std::clamp(band.magnitude_dB / (2.0f * k_transfer_range_dB), -0.5f, 0.5f);
+            transfer_line_.setYAt(i, (0.5f - magnitude) * h);
+            coherence_line_.setYAt(i, (1.0f - band.coherence) * h);
+        }
+
+        transfer_line_.redraw();
+        coherence_line_.redraw();
+    }
+
+    static constexpr int k_line_thickness = 2;
+    static constexpr int k_min_poll_interval_ms = 8;
+    static constexpr float k_transfer_range_dB = 24.0f; ///< The transfer function spans +-24 dB
+    static constexpr int k_reference_line = k_max_traces - 1;
+
     AnalyzerProcessor& analyzer_processor_;
+    std::array<GraphLine, k_max_traces> lines_ { GraphLine(2), GraphLine(2), GraphLine(2) };
+    int num_traces_ = 0;
+    GraphLine transfer_line_ { 2 };
+    GraphLine coherence_line_ { 2 };
+    bool shows_reference_ = false;
+    bool shows_transfer_function_ = false;
+    int num_transfer_points_ = 0;
+    uint64_t line_x_version_ = 0;
+    float view_min_x_ = 0.0f;
+    float view_max_x_ = 1.0f;
+    EventTimer timer_;
+    int timer_interval_ms_ = 0;
+    std::chrono::steady_clock::time_point last_poll_time_ = std::chrono::steady_clock::now();
 
     VISAGE_LEAK_CHECKER(AnalyzerFrame)
 };
\ No newline at end of file
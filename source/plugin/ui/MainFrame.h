@@ -9,20 +9,19 @@
 #include "GridFrame.h"
 #include "OverlayFrame.h"
 #include "ParametersFrame.h"
+#include "QualityFrame.h"
 
 class MainFrame : public Frame {
   public:
     MainFrame(State& state, AnalyzerProcessor& analyzerProcessor) :
-        state_(state), analyzer_(analyzerProcessor), parameter_panel_(state) {
+        state_(state), analyzer_(analyzerProcessor), quality_(state), parameter_panel_(state) {
         addChild(grid_);
         addChild(analyzer_);
         addChild(freq_labels_);
         addChild(dB_labels_);
+        addChild(quality_);
         addChild(parameter_panel_);
 
-        grid_.setFrequencyRange(k_min_frequency, k_max_frequency);
-        freq_labels_.setFrequencyRange(k_min_frequency, k_max_frequency);
-
         state_listener_ = state.addListener([this] { stateChanged(); });
         stateChanged();
     }
@@ -52,10 +51,34 @@ class MainFrame : public Frame {
         grid_.setBounds(b);
         analyzer_.setBounds(b);
         dB_labels_.setBounds(Bounds(b).trimRight(42));
+
+        {
+            // Top right, clear of the dB labels
+            auto quality_bounds = Bounds(b).trimTop(40);
+            quality_bounds.trimTop(14);
+            quality_bounds.trimRight(50);
+            quality_.setBounds(quality_bounds);
+        }
+
         freq_labels_.setBounds(b.trimBottom(20));
     }
 
     void stateChanged() {
+        analyzer_.setFrameRate(state_.frameRate());
+        analyzer_.setShowsReference(state_.sidechain_enabled());
+        analyzer_.setShowsTransferFunction(state_.transfer_function_enabled());
+
+        // Zooming & panning is purely a matter of display, the analyzer's bands always span
+        // k_min_frequency to k_max_frequency
+        const auto min_freq = state_.view_min_frequency();
+        const auto max_freq = state_.view_max_frequency();
+        const auto to_x = [](float freq) {
+            return tb::to0to1(std::log(freq), std::log(k_min_frequency), std::log(k_max_frequency));
+        };
+        analyzer_.setViewRange(to_x(min_freq), to_x(max_freq));
+        grid_.setFrequencyRange(min_freq, max_freq);
+        freq_labels_.setFrequencyRange(min_freq, max_freq);
+
         resized();
     }
 
@@ -66,6 +89,7 @@ class MainFrame : public Frame {
     AnalyzerFrame analyzer_;
     FrequencyGridLabelsFrame freq_labels_;
     DbGridLabelsFrame dB_labels_;
+    QualityFrame quality_;
     ParameterPanel parameter_panel_;
 
     std::unique_ptr<State::Listener> state_listener_;
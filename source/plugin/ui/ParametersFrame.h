@@ -1,6 +1,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+
 #include "common/Common.h"
 #include "common/Shelf.h"
 #include "embedded/Fonts.h"
@@ -86,6 +89,35 @@ class ParameterPanel : public Frame {
                 showRightClickMenu(e.position);
         };
 
+        // Zoom around the mouse with the wheel and pan by dragging. The panel covers the whole
+        // analyzer, so it's the one that gets these events, but only the ones over the plot
+        // itself count.
+        onMouseWheel() += [this](const MouseEvent& e) {
+            if (! isOverPlot(e.position))
+                return false;
+
+            const auto zoom = std::exp2(-e.wheel_delta_y * k_octaves_per_wheel_step);
+            zoomView(e.position.x / width(), zoom);
+            return true;
+        };
+
+        onMouseDown() += [this](const MouseEvent& e) {
+            panning_ = isOverPlot(e.position);
+            drag_start_x_ = e.position.x;
+            drag_start_min_freq_ = state_.view_min_frequency();
+            drag_start_max_freq_ = state_.view_max_frequency();
+        };
+
+        onMouseDrag() += [this](const MouseEvent& e) {
+            if (! panning_ || ! e.isLeftButton())
+                return;
+
+            // Dragging right brings lower frequencies into view
+            const auto octaves = std::log2(drag_start_max_freq_ / drag_start_min_freq_);
+            const auto shift = std::exp2(-(e.position.x - drag_start_x_) / width() * octaves);
+            state_.setViewFrequencyRange(drag_start_min_freq_ * shift, drag_start_max_freq_ * shift);
+        };
+
         state_listener_ = state.addListener([this] { stateChanged(); });
         stateChanged();
     }
@@ -127,7 +159,7 @@ class ParameterPanel : public Frame {
                 frame.setBounds(button.bounds().xCenter() - w / 2, shelf_.y() - h, w, h);
             };
 
-            center_frame_above_button(resolution_frame_, resolution_button_, 116, 96);
+            center_frame_above_button(resolution_frame_, resolution_button_, 116, 183);
             center_frame_above_button(range_frame_, range_button_, 92, 88);
             center_frame_above_button(tilt_frame_, tilt_button_, 116, 64);
             center_frame_above_button(smoothing_frame_, smoothing_button_, 116, 96);
@@ -135,6 +167,27 @@ class ParameterPanel : public Frame {
     }
 
   private:
+    // Whether a position is over the plot, rather than over the controls or their pop-ups
+    bool isOverPlot(const Point& position) const {
+        if (! state_.hide_controls() && position.y >= shelf_.y())
+            return false;
+
+        const std::array<const Frame*, 4> pop_ups = { &resolution_frame_, &range_frame_, &tilt_frame_, &smoothing_frame_ };
+        return std::ranges::none_of(pop_ups, [&](const Frame* frame) {
+            return frame->isVisible() && frame->bounds().contains(position);
+        });
+    }
+
+    // Scales the visible range by `zoom` in log frequency, keeping the frequency at `anchor` (0
+    // being the left edge & 1 the right one) in place
+    void zoomView(float anchor, float zoom) {
+        const auto min_log = std::log2(state_.view_min_frequency());
+        const auto max_log = std::log2(state_.view_max_frequency());
+        const auto anchor_log = min_log + anchor * (max_log - min_log);
+        state_.setViewFrequencyRange(std::exp2(anchor_log - (anchor_log - min_log) * zoom),
+                                     std::exp2(anchor_log + (max_log - anchor_log) * zoom));
+    }
+
     void handleMouse(const MouseEvent& e, bool is_exiting) {
         auto show_only = [this](Frame* frame_to_show, Frame* button_to_highlight) {
             timer_.stopTimer();
@@ -182,11 +235,26 @@ class ParameterPanel : public Frame {
         PopupMenu menu;
         menu.addOption(0, "Reset to default parameters");
         menu.addOption(1, state_.hide_controls() ? "Show controls" : "Hide controls");
+        menu.addOption(2, state_.governor_enabled() ? "Keep full quality under CPU load"
+                                                    : "Reduce quality under CPU load");
+        if (state_.isZoomed())
+            menu.addOption(3, "Reset zoom");
+        menu.addOption(4, state_.sidechain_enabled() ? "Hide sidechain reference" : "Show sidechain reference");
+        menu.addOption(5, state_.transfer_function_enabled() ? "Hide transfer function"
+                                                             : "Show transfer function from sidechain");
         menu.onSelection() = [this](int id) {
             if (id == 0) {
                 state_.resetToDefaults();
             } else if (id == 1) {
                 state_.setHideControls(! state_.hide_controls());
+            } else if (id == 2) {
+                state_.setGovernorEnabled(! state_.governor_enabled());
+            } else if (id == 3) {
+                state_.setViewFrequencyRange(k_min_frequency, k_max_frequency);
+            } else if (id == 4) {
+                state_.setSidechainEnabled(! state_.sidechain_enabled());
+            } else if (id == 5) {
+                state_.setTransferFunctionEnabled(! state_.transfer_function_enabled());
             }
         };
         menu.show(this, position);
@@ -209,6 +277,12 @@ class ParameterPanel : public Frame {
     SmoothingFrame smoothing_frame_;
     EventTimer timer_;
 
+    static constexpr float k_octaves_per_wheel_step = 0.5f;
+    bool panning_ = false;
+    float drag_start_x_ = 0.0f;
+    float drag_start_min_freq_ = k_min_frequency;
+    float drag_start_max_freq_ = k_max_frequency;
+
     std::unique_ptr<State::Listener> state_listener_;
 
     VISAGE_LEAK_CHECKER(ParameterPanel)
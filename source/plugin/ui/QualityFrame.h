@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cmath>
+
+#include "../State.h"
+
+#include "common/Common.h"
+#include "embedded/Fonts.h"
+
+/** Shows what the governor had to turn down, if anything, to stay within the CPU budget */
+class QualityFrame : public Frame {
+  public:
+    QualityFrame(State& state) : state_(state) {
+        setIgnoresMouseEvents(true, true);
+
+        state_listener_ = state.addListener([this] { redraw(); });
+    }
+
+    void draw(Canvas& canvas) override {
+        const auto reduction = state_.quality_reduction();
+        if (reduction == State::QualityReduction::None)
+            return;
+
+        const auto params = state_.analyzerParameters();
+        std::string text = "Reduced for CPU: ";
+        text += std::to_string(static_cast<int>(std::lround(params.overlap * 100.0f))) + "% overlap";
+
+        if (reduction >= State::QualityReduction::LowerFrameRate)
+            text += ", " + std::to_string(static_cast<int>(state_.frameRate())) + " fps";
+
+        if (reduction >= State::QualityReduction::NoCurve)
+            text += ", no curve";
+
+        if (reduction >= State::QualityReduction::FewerBands)
+            text += ", " + std::to_string(params.target_num_bands) + " bands";
+
+        canvas.setColor(0xff9a9a9a);
+        canvas.text(text, { 11, resources::fonts::NotoSans_Regular_ttf }, Font::kRight,
+                    0, 0, width(), height());
+    }
+
+  private:
+    State& state_;
+
+    std::unique_ptr<State::Listener> state_listener_;
+
+    VISAGE_LEAK_CHECKER(QualityFrame)
+};
@@ -11,10 +11,16 @@
 
 class ResolutionFrame : public FadeFrame {
 public:
+    static constexpr std::array k_overlaps { 0.5f, 0.75f, 0.875f };
+    static constexpr std::array k_frame_rate_caps { 30, 60, 120, 0 };
+
     ResolutionFrame(State& state) : state_(state) {
         addChild(bands_slider_);
         addChild(fft_menu_button_);
+        addChild(overlap_menu_button_);
+        addChild(frame_rate_menu_button_);
         addChild(window_menu_button_);
+        addChild(channel_menu_button_);
 
         bands_slider_.onTextEnter() += [this](const String& text) {
             state_.setTargetNumBands(text.toInt());
@@ -25,7 +31,10 @@ public:
         };
 
         fft_menu_button_.onToggle() += [this](Button*, bool){ showFftWindow(); };
+        overlap_menu_button_.onToggle() += [this](Button*, bool){ showOverlapMenu(); };
+        frame_rate_menu_button_.onToggle() += [this](Button*, bool){ showFrameRateMenu(); };
         window_menu_button_.onToggle() += [this](Button*, bool){ showWindowMenu(); };
+        channel_menu_button_.onToggle() += [this](Button*, bool){ showChannelMenu(); };
 
         state_listener_ = state.addListener([this] { handleStateChange(); });
         handleStateChange();
@@ -34,7 +43,10 @@ public:
     void resized() override {
         bands_slider_.setBounds(51, 8, 54, 19);
         fft_menu_button_.setBounds(51, 37, 54, 19);
-        window_menu_button_.setBounds(8, 66, 100, 19);
+        overlap_menu_button_.setBounds(51, 66, 54, 19);
+        frame_rate_menu_button_.setBounds(51, 95, 54, 19);
+        window_menu_button_.setBounds(8, 124, 100, 19);
+        channel_menu_button_.setBounds(8, 153, 100, 19);
     }
 
     void drawBackground(Canvas& canvas, float /*hoverAmount*/) override {
@@ -60,6 +72,8 @@ public:
             const Font font(11, resources::fonts::NotoSans_Regular_ttf);
             canvas.text("Bands", font, Font::kLeft, 9, 10, 34, 15);
             canvas.text("FFT", font, Font::kLeft, 9, 39, 34, 15);
+            canvas.text("Overlap", font, Font::kLeft, 9, 68, 42, 15);
+            canvas.text("Rate", font, Font::kLeft, 9, 97, 34, 15);
         }
     }
 
@@ -69,6 +83,8 @@ public:
     void handleStateChange() {
         bands_slider_.setText(std::to_string(state_.target_num_bands()));
         fft_menu_button_.setText(std::to_string(state_.fft_size()));
+        overlap_menu_button_.setText(overlapName(state_.overlap()));
+        frame_rate_menu_button_.setText(frameRateName(state_.frame_rate_cap()));
 
         {
             auto window_name = std::string(magic_enum::enum_name(state_.window_type()));
@@ -77,6 +93,8 @@ public:
 
             window_menu_button_.setText(window_name);
         }
+
+        channel_menu_button_.setText(channelModeName(state_.channel_mode()));
     }
 
     void showFftWindow() {
@@ -90,6 +108,37 @@ public:
         menu.show(&fft_menu_button_);
     }
 
+    void showOverlapMenu() {
+        PopupMenu menu;
+        for (int i = 0; i < static_cast<int>(k_overlaps.size()); i++)
+            menu.addOption(i, overlapName(k_overlaps[i]));
+
+        menu.onSelection() = [this](int id) { state_.setOverlap(k_overlaps[id]); };
+        menu.show(&overlap_menu_button_);
+    }
+
+    static std::string overlapName(float overlap) {
+        // Show 87.5 rather than rounding it to 88
+        const auto percent = overlap * 100.0f;
+        if (percent == std::round(percent))
+            return std::to_string(static_cast<int>(percent)) + "%";
+
+        return String(percent, 1).toUtf8() + "%";
+    }
+
+    void showFrameRateMenu() {
+        PopupMenu menu;
+        for (int i = 0; i < static_cast<int>(k_frame_rate_caps.size()); i++)
+            menu.addOption(i, frameRateName(k_frame_rate_caps[i]));
+
+        menu.onSelection() = [this](int id) { state_.setFrameRateCap(k_frame_rate_caps[id]); };
+        menu.show(&frame_rate_menu_button_);
+    }
+
+    static std::string frameRateName(int frame_rate_cap) {
+        return frame_rate_cap > 0 ? std::to_string(frame_rate_cap) + " fps" : "Uncapped";
+    }
+
     void showWindowMenu() {
         PopupMenu menu;
         for (auto e : magic_enum::enum_entries<tb::WindowType>()) {
@@ -108,11 +157,45 @@ public:
         menu.show(&window_menu_button_);
     }
 
+    void showChannelMenu() {
+        PopupMenu menu;
+        for (auto mode : magic_enum::enum_values<ChannelMode>()) {
+            if (isAvailable(mode, state_.input_layout()))
+                menu.addOption(static_cast<int>(mode), channelModeName(mode));
+        }
+
+        menu.onSelection() = [this](int id) { state_.setChannelMode(static_cast<ChannelMode>(id)); };
+        menu.show(&channel_menu_button_);
+    }
+
+    static std::string channelModeName(ChannelMode mode) {
+        switch (mode) {
+            case ChannelMode::MonoSum:   return "Mono";
+            case ChannelMode::Left:      return "Left";
+            case ChannelMode::Right:     return "Right";
+            case ChannelMode::LeftRight: return "Left + Right";
+            case ChannelMode::Mid:       return "Mid";
+            case ChannelMode::Side:      return "Side";
+            case ChannelMode::MidSide:   return "Mid + Side";
+            case ChannelMode::Center:    return "Center";
+            case ChannelMode::Lfe:       return "LFE";
+            case ChannelMode::Surrounds: return "Surrounds";
+            case ChannelMode::Rears:     return "Rears";
+            case ChannelMode::TopFront:  return "Top Front";
+            case ChannelMode::TopRear:   return "Top Rear";
+        }
+
+        return {};
+    }
+
     State& state_;
 
     TextSlider bands_slider_;
     MenuButton fft_menu_button_;
+    MenuButton overlap_menu_button_;
+    MenuButton frame_rate_menu_button_;
     MenuButton window_menu_button_;
+    MenuButton channel_menu_button_;
 
     std::unique_ptr<State::Listener> state_listener_;
 
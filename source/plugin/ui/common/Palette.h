@@ -7,11 +7,49 @@ namespace spectrum {
 
 inline Color backgroundColor() { return {0xff171818}; }
 
+// The second analyzer trace, e.g. the right or side channel
+VISAGE_THEME_PALETTE_OVERRIDE(SecondTrace, false);
+
+// The sidechain reference trace
+VISAGE_THEME_PALETTE_OVERRIDE(ReferenceTrace, false);
+
+// The transfer function's magnitude & coherence
+VISAGE_THEME_PALETTE_OVERRIDE(TransferTrace, false);
+VISAGE_THEME_PALETTE_OVERRIDE(CoherenceTrace, false);
+
 class Palette : public visage::Palette {
 public:
     Palette() {
         setColor(TextEditor::TextEditorBackground, 0xff1e1e1e);
         setColor(TextEditor::TextEditorText, 0xffffffff);
+
+        // Blue analyzer line & fill, fading out over the bottom half
+        const auto fill_color = Color(0x358BDB).withAlpha(0.62);
+        const auto line_color = Color(0x63AFF2).withAlpha(1.0);
+        setColor(GraphLine::LineFillColor, Brush::vertical(Gradient(fill_color, fill_color, fill_color.withAlpha(0))));
+        setColor(GraphLine::LineColor, Brush::vertical(Gradient(line_color, line_color, line_color.withAlpha(0))));
+        setValue(GraphLine::LineWidth, 2.0f);
+
+        // Orange for the second trace, with a lighter fill so that the first one shows through
+        const auto second_fill_color = Color(0xD9822B).withAlpha(0.35);
+        const auto second_line_color = Color(0xF2A25C).withAlpha(1.0);
+        setColor(SecondTrace, GraphLine::LineFillColor,
+                 Brush::vertical(Gradient(second_fill_color, second_fill_color, second_fill_color.withAlpha(0))));
+        setColor(SecondTrace, GraphLine::LineColor,
+                 Brush::vertical(Gradient(second_line_color, second_line_color, second_line_color.withAlpha(0))));
+
+        // A pale line with barely any fill for the reference, so that it reads as a backdrop
+        const auto reference_fill_color = Color(0xC8C8C8).withAlpha(0.12);
+        const auto reference_line_color = Color(0xE0E0E0).withAlpha(0.8);
+        setColor(ReferenceTrace, GraphLine::LineFillColor,
+                 Brush::vertical(Gradient(reference_fill_color, reference_fill_color, reference_fill_color.withAlpha(0))));
+        setColor(ReferenceTrace, GraphLine::LineColor,
+                 Brush::vertical(Gradient(reference_line_color, reference_line_color, reference_line_color.withAlpha(0))));
+
+        // No fill for the transfer function, which sits on top of the spectra. The coherence is
+        // faint, as it's only there to tell which parts of the magnitude to trust.
+        setColor(TransferTrace, GraphLine::LineColor, Color(0xff7CD992));
+        setColor(CoherenceTrace, GraphLine::LineColor, Color(0xff7CD992).withAlpha(0.3));
     }
 };
 
@@ -0,0 +1,85 @@
+#include "AnalyzerCache.h"
+
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+// Tests that identical settings share one copy, and that unused entries get released
+TEST_CASE("Analyzer cache sharing", "[cache]") {
+    SECTION("Windows") {
+        const auto a = analyzer_cache::window(tb::WindowType::Hann, 1'024);
+        const auto b = analyzer_cache::window(tb::WindowType::Hann, 1'024);
+        REQUIRE(a == b);
+        REQUIRE(a->values.size() == 1'024);
+
+        REQUIRE(analyzer_cache::window(tb::WindowType::Hann, 2'048) != a);
+        REQUIRE(analyzer_cache::window(tb::WindowType::BlackmanHarris, 1'024) != a);
+
+        double sum = 0.0;
+        for (auto v : a->values)
+            sum += v;
+
+        REQUIRE(a->sum == Catch::Approx(sum));
+    }
+
+    SECTION("Entries get released once unused") {
+        std::weak_ptr<const SharedWindow> weak = analyzer_cache::window(tb::WindowType::Hann, 512);
+        REQUIRE(weak.expired());
+    }
+}
+
+TEST_CASE("Analyzer cache concurrent use", "[cache]") {
+    std::vector<std::unique_ptr<FftPlan>> ffts(8);
+    std::vector<std::shared_ptr<const SharedWindow>> windows(ffts.size());
+    std::vector<float> magnitudes(ffts.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < ffts.size(); ++t) {
+        threads.emplace_back([&fft = ffts[t], &window = windows[t], &magnitude = magnitudes[t]] {
+            window = analyzer_cache::window(tb::WindowType::Hann, 4'096);
+            fft = std::make_unique<FftPlan>(4'096);
+
+            // Concurrent transforms on separate plans must give the same result as serial ones
+            std::vector<float> in(4'096, 0.0f);
+            in[1] = 1.0f;
+            std::vector<std::complex<float>> out(2'049);
+            for (int i = 0; i < 20; ++i)
+                fft->forward(in.data(), out.data());
+
+            magnitude = std::abs(out[10]);
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    // Catch assertions aren't thread-safe, so check the results here
+    for (size_t t = 0; t < ffts.size(); ++t) {
+        REQUIRE(windows[t] == windows.front());
+        REQUIRE(ffts[t]->size() == 4'096);
+        REQUIRE(ffts[t]->scale() == ffts.front()->scale());
+        REQUIRE(magnitudes[t] == Catch::Approx(ffts[t]->scale()));
+    }
+}
+
+TEST_CASE("FftPlan forwardEach", "[cache]") {
+    // Each block must come out as if transformed on its own, at its own stride
+    FftPlan fft(256);
+    constexpr int num_blocks = 3;
+    constexpr size_t num_bins = 129;
+    std::vector<float> in(256 * num_blocks, 0.0f);
+    for (int block = 0; block < num_blocks; ++block)
+        in[static_cast<size_t>(block) * 256 + static_cast<size_t>(block) + 1] = 1.0f;
+
+    std::vector<std::complex<float>> out(num_bins * num_blocks);
+    fft.forwardEach(in.data(), out.data(), num_blocks);
+
+    std::vector<std::complex<float>> expected(num_bins);
+    for (int block = 0; block < num_blocks; ++block) {
+        fft.forward(in.data() + static_cast<size_t>(block) * 256, expected.data());
+        for (size_t bin = 0; bin < num_bins; ++bin) {
+            REQUIRE(out[static_cast<size_t>(block) * num_bins + bin].real() == Catch::Approx(expected[bin].real()).margin(1e-6));
+            REQUIRE(out[static_cast<size_t>(block) * num_bins + bin].imag() == Catch::Approx(expected[bin].imag()).margin(1e-6));
+        }
+    }
+}
@@ -0,0 +1,327 @@
+#include "AnalyzerKernels.h"
+
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<std::complex<float>> makeRandomBins(int count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<std::complex<float>> bins(count);
+    for (auto& bin : bins)
+        bin = { dist(rng), dist(rng) };
+
+    return bins;
+}
+
+std::vector<float> makeRandomWeights(int count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(0.0f, 4.0f);
+    std::vector<float> weights(count);
+    for (auto& weight : weights)
+        weight = dist(rng);
+
+    return weights;
+}
+
+}
+
+// Tests the vectorized band reduction against a plain scalar reference
+TEST_CASE("Kernels max weighted power", "[kernels]") {
+    std::mt19937 rng(1234);
+
+    SECTION("Empty run") {
+        REQUIRE(kernels::maxWeightedPower(nullptr, nullptr, 0) == 0.0f);
+    }
+
+    SECTION("Matches the scalar reference for all run lengths and offsets") {
+        const auto bins = makeRandomBins(200, rng);
+        const auto weights = makeRandomWeights(200, rng);
+
+        // Odd offsets make sure unaligned starts are handled, odd counts exercise the tails
+        for (int offset = 0; offset < 3; ++offset) {
+            for (int count = 1; count < 67; ++count) {
+                float expected = 0.0f;
+                for (int i = offset; i < offset + count; ++i)
+                    expected = std::max(expected, std::norm(bins[i]) * weights[i]);
+
+                const auto actual = kernels::maxWeightedPower(bins.data() + offset, weights.data() + offset, count);
+
+                INFO("Offset: " << offset << ", count: " << count);
+                REQUIRE(actual == Catch::Approx(expected).epsilon(1e-6));
+            }
+        }
+    }
+
+    SECTION("Finds a peak in any position") {
+        std::vector<std::complex<float>> bins(37, { 0.001f, 0.0f });
+        const std::vector<float> weights(bins.size(), 1.0f);
+        for (size_t peak = 0; peak < bins.size(); ++peak) {
+            auto b = bins;
+            b[peak] = { 3.0f, 4.0f };
+            REQUIRE(kernels::maxWeightedPower(b.data(), weights.data(), static_cast<int>(b.size())) ==
+                    Catch::Approx(25.0f));
+        }
+    }
+}
+
+TEST_CASE("Kernels power to dB", "[kernels]") {
+    SECTION("Fast log stays within the documented error bound over the full range") {
+        // Sweep from just above the smallest normal float up to 300 dB, in steps that don't line
+        // up with the octaves, so that the whole mantissa range gets covered at every exponent
+        constexpr float floor_dB = -370.0f;
+        std::vector<float> power;
+        for (double dB = -370.0; dB < 300.0; dB += 0.0137)
+            power.push_back(static_cast<float>(std::pow(10.0, dB / 10.0)));
+
+        const auto count = static_cast<int>(power.size());
+        std::vector<float> fast(power.size());
+        std::vector<float> exact(power.size());
+        kernels::powerToDb(power.data(), fast.data(), count, floor_dB, false);
+        kernels::powerToDb(power.data(), exact.data(), count, floor_dB, true);
+
+        double max_error = 0.0;
+        for (size_t i = 0; i < power.size(); ++i) {
+            const auto reference = std::max<double>(floor_dB, 10.0 * std::log10(static_cast<double>(power[i])));
+            max_error = std::max(max_error, std::abs(fast[i] - reference));
+            REQUIRE(exact[i] == Catch::Approx(reference).margin(1e-4));
+        }
+
+        INFO("Max error: " << max_error << " dB");
+        REQUIRE(max_error < kernels::k_fast_log_max_error_dB);
+    }
+
+    SECTION("Clamps to the floor") {
+        const std::vector<float> power = { 0.0f, -1.0f, FLT_MIN / 4.0f, 1e-12f, 1e-10f, 1.0f, 0.0f };
+        for (const auto exact : { false, true }) {
+            std::vector<float> dB(power.size());
+            kernels::powerToDb(power.data(), dB.data(), static_cast<int>(power.size()), -100.0f, exact);
+
+            INFO("Exact: " << exact);
+            REQUIRE(dB[0] == -100.0f);
+            REQUIRE(dB[1] == -100.0f);
+            REQUIRE(dB[2] == -100.0f);
+            REQUIRE(dB[3] == -100.0f);
+            REQUIRE(dB[4] == Catch::Approx(-100.0f).margin(kernels::k_fast_log_max_error_dB));
+            REQUIRE(dB[5] == Catch::Approx(0.0f).margin(kernels::k_fast_log_max_error_dB));
+            REQUIRE(dB[6] == -100.0f);
+        }
+    }
+}
+
+TEST_CASE("Kernels band levels", "[kernels]") {
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> power_dist(0.0f, 2.0f);
+    std::uniform_real_distribution<float> dB_dist(-100.0f, 10.0f);
+
+    const kernels::BandLevelParameters params { .floor_dB = -100.0f, .attack = 0.8f, .release = 0.1f };
+
+    // Odd counts exercise the tails
+    for (int count = 1; count < 40; ++count) {
+        std::vector<float> power(count);
+        std::vector<float> dB(count);
+        for (int i = 0; i < count; ++i) {
+            power[i] = power_dist(rng);
+            dB[i] = dB_dist(rng);
+        }
+
+        auto expected = dB;
+        for (int i = 0; i < count; ++i) {
+            const auto target = power[i] > 0.0f ? std::max(-100.0f, 10.0f * std::log10(power[i])) : -100.0f;
+            const auto coefficient = target > expected[i] ? params.attack : params.release;
+            expected[i] += coefficient * (target - expected[i]);
+        }
+
+        std::vector<float> target(count);
+        kernels::updateBandLevels(power.data(), target.data(), dB.data(), count, params);
+
+        for (int i = 0; i < count; ++i) {
+            INFO("Count: " << count << ", band: " << i);
+            const auto expected_target = power[i] > 0.0f ? std::max(-100.0f, 10.0f * std::log10(power[i])) : -100.0f;
+            REQUIRE(target[i] == Catch::Approx(expected_target).margin(kernels::k_fast_log_max_error_dB));
+            REQUIRE(dB[i] == Catch::Approx(expected[i]).margin(kernels::k_fast_log_max_error_dB));
+        }
+
+        // Moving on towards the same targets
+        kernels::approachBandLevels(target.data(), dB.data(), count, params.attack, params.release);
+        for (int i = 0; i < count; ++i) {
+            const auto coefficient = target[i] > expected[i] ? params.attack : params.release;
+            expected[i] += coefficient * (target[i] - expected[i]);
+
+            INFO("Count: " << count << ", band: " << i);
+            REQUIRE(dB[i] == Catch::Approx(expected[i]).margin(kernels::k_fast_log_max_error_dB));
+        }
+    }
+}
+
+TEST_CASE("Kernels normalize", "[kernels]") {
+    const std::vector<float> dB = { -100.0f, -50.0f, 0.0f, 10.0f, -120.0f };
+    std::vector<float> y(dB.size());
+    kernels::normalize(dB.data(), y.data(), static_cast<int>(dB.size()), -100.0f, 0.0f);
+
+    REQUIRE(y[0] == Catch::Approx(0.0f).margin(1e-6));
+    REQUIRE(y[1] == Catch::Approx(0.5f));
+    REQUIRE(y[2] == Catch::Approx(1.0f));
+    REQUIRE(y[3] == Catch::Approx(1.1f));
+    REQUIRE(y[4] == Catch::Approx(-0.2f));
+}
+
+TEST_CASE("Kernels max abs difference", "[kernels]") {
+    REQUIRE(kernels::maxAbsDifference(nullptr, nullptr, 0) == 0.0f);
+
+    // Odd counts exercise the tails
+    for (int count = 1; count < 40; ++count) {
+        for (int peak = 0; peak < count; ++peak) {
+            std::vector<float> a(count, -10.0f);
+            std::vector<float> b(count, -10.5f);
+            b[peak] = peak % 2 == 0 ? -13.0f : -7.0f;
+
+            INFO("Count: " << count << ", peak: " << peak);
+            REQUIRE(kernels::maxAbsDifference(a.data(), b.data(), count) == Catch::Approx(3.0f));
+        }
+    }
+}
+
+TEST_CASE("Kernels Catmull-Rom", "[kernels]") {
+    std::mt19937 rng(2468);
+    std::uniform_real_distribution<float> dist(-1.0f, 2.0f);
+
+    // Odd counts exercise the tails
+    for (const auto steps : { 1, 4, 10 }) {
+        std::vector<float> basis(4 * steps);
+        kernels::catmullRomBasis(basis.data(), steps);
+
+        for (int count = 4; count < 30; ++count) {
+            std::vector<float> control(count);
+            for (auto& value : control)
+                value = dist(rng);
+
+            std::vector<float> out((count - 3) * steps + 1);
+            kernels::catmullRom(control.data(), count, basis.data(), steps, out.data());
+
+            for (int segment = 0; segment < count - 3; ++segment) {
+                const auto a = control[segment];
+                const auto b = control[segment + 1];
+                const auto c = control[segment + 2];
+                const auto d = control[segment + 3];
+                for (int k = 0; k < steps; ++k) {
+                    const auto t = static_cast<float>(k) / static_cast<float>(steps);
+                    const auto expected = 0.5f * (2.0f * b + (-a + c) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t * t +
+                                                  (-a + 3.0f * b - 3.0f * c + d) * t * t * t);
+
+                    INFO("Steps: " << steps << ", count: " << count << ", segment: " << segment << ", step: " << k);
+                    REQUIRE(out[segment * steps + k] == Catch::Approx(expected).margin(1e-5));
+                }
+            }
+
+            // The spline passes through the inner control points and ends on the second to last one
+            for (int segment = 0; segment < count - 3; ++segment)
+                REQUIRE(out[segment * steps] == Catch::Approx(control[segment + 1]).margin(1e-6));
+
+            REQUIRE(out.back() == control[count - 2]);
+        }
+    }
+}
+
+TEST_CASE("Kernels Catmull-Rom points", "[kernels]") {
+    std::mt19937 rng(8642);
+    std::uniform_real_distribution<float> dist(-1.0f, 2.0f);
+
+    std::vector<float> control(20);
+    for (auto& value : control)
+        value = dist(rng);
+
+    // Each segment gets its own steps, so every point has to match the uniform spline with the
+    // same steps at the same segment
+    std::vector<int> segments;
+    std::vector<float> weights;
+    std::vector<float> expected;
+    for (int segment = 0; segment + 3 < static_cast<int>(control.size()); ++segment) {
+        const auto steps = 1 + segment % 5;
+        std::vector<float> basis(4 * steps);
+        kernels::catmullRomBasis(basis.data(), steps);
+
+        std::vector<float> uniform((control.size() - 3) * steps + 1);
+        kernels::catmullRom(control.data(), static_cast<int>(control.size()), basis.data(), steps, uniform.data());
+        for (int k = 0; k < steps; ++k) {
+            segments.push_back(segment);
+            weights.insert(weights.end(), basis.begin() + 4 * k, basis.begin() + 4 * k + 4);
+            expected.push_back(uniform[segment * steps + k]);
+        }
+    }
+
+    std::vector<float> out(segments.size());
+    kernels::catmullRomPoints(control.data(), segments.data(), weights.data(), static_cast<int>(segments.size()),
+                              out.data());
+    for (size_t i = 0; i < out.size(); ++i) {
+        INFO("Point: " << i);
+        REQUIRE(out[i] == Catch::Approx(expected[i]).margin(1e-5));
+    }
+}
+
+TEST_CASE("Kernels mix channels", "[kernels]") {
+    std::mt19937 rng(1357);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // Includes zero gains, which skip their input, & odd counts, which exercise the tails
+    const std::vector<float> gains = { 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.7f, -0.7f, 0.25f };
+    for (int count = 0; count < 40; ++count) {
+        std::vector<std::vector<float>> in(3, std::vector<float>(count));
+        for (auto& channel : in) {
+            for (auto& sample : channel)
+                sample = dist(rng);
+        }
+
+        std::vector<std::vector<float>> out(3, std::vector<float>(count, 123.0f));
+        const float* in_ptrs[] = { in[0].data(), in[1].data(), in[2].data() };
+        float* out_ptrs[] = { out[0].data(), out[1].data(), out[2].data() };
+        kernels::mixChannels(in_ptrs, 3, out_ptrs, 3, gains.data(), count);
+
+        for (int output = 0; output < 3; ++output) {
+            for (int i = 0; i < count; ++i) {
+                float expected = 0.0f;
+                for (int input = 0; input < 3; ++input)
+                    expected += gains[output * 3 + input] * in[input][i];
+
+                INFO("Count: " << count << ", output: " << output << ", sample: " << i);
+                REQUIRE(out[output][i] == Catch::Approx(expected).margin(1e-6));
+            }
+        }
+    }
+}
+
+TEST_CASE("Kernels average cross spectra", "[kernels]") {
+    std::mt19937 rng(9753);
+    constexpr int count = 37;
+
+    std::vector<float> xx(count, 0.0f), yy(count, 0.0f);
+    std::vector<std::complex<float>> xy(count, 0.0f);
+    std::vector<double> expected_xx(count, 0.0), expected_yy(count, 0.0);
+    std::vector<std::complex<double>> expected_xy(count, 0.0);
+
+    // 1 / n weights give the plain mean over all frames
+    constexpr int num_frames = 5;
+    for (int frame = 1; frame <= num_frames; ++frame) {
+        const auto x = makeRandomBins(count, rng);
+        const auto y = makeRandomBins(count, rng);
+        kernels::averageCrossSpectra(x.data(), y.data(), xx.data(), yy.data(), xy.data(), count,
+                                     1.0f / static_cast<float>(frame));
+
+        for (int i = 0; i < count; ++i) {
+            expected_xx[i] += std::norm(std::complex<double>(x[i])) / num_frames;
+            expected_yy[i] += std::norm(std::complex<double>(y[i])) / num_frames;
+            expected_xy[i] += std::conj(std::complex<double>(x[i])) * std::complex<double>(y[i]) / double { num_frames };
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        INFO("Bin: " << i);
+        REQUIRE(xx[i] == Catch::Approx(expected_xx[i]).epsilon(1e-5));
+        REQUIRE(yy[i] == Catch::Approx(expected_yy[i]).epsilon(1e-5));
+        REQUIRE(xy[i].real() == Catch::Approx(expected_xy[i].real()).margin(1e-3));
+        REQUIRE(xy[i].imag() == Catch::Approx(expected_xy[i].imag()).margin(1e-3));
+    }
+}
@@ -1,8 +1,17 @@
 #include "AnalyzerProcessor.h"
 
+#include <algorithm>
+#include <array>
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cmath>
 #include <choc/audio/choc_Oscillators.h>
+#include <future>
+#include <numbers>
+#include <random>
+#include <thread>
+#include <utility>
 
 namespace {
 
@@ -135,7 +144,7 @@ TEST_CASE("AnalyzerProcessor audio processing", "[analyzer]") {
         }
 
         // Calculate acceptable tolerance based on FFT resolution
-        const float binWidth = static_cast<float>(p.sample_rate) / p.fft_size;
+        const float binWidth = static_cast<float>(p.sample_rate) / static_cast<float>(p.fft_size);
         const float tolerance = binWidth * 2.f;
 
         INFO("Peak frequency: " << peakFreq << ", Expected: " << testFreq);
@@ -179,6 +188,38 @@ TEST_CASE("AnalyzerProcessor reset functionality", "[analyzer]") {
         REQUIRE(band.dB == Catch::Approx(analyzer.minDb()).margin(0.001f));
 }
 
+// Tests that every hop gets analysed exactly once, regardless of how often the analyzer runs
+TEST_CASE("AnalyzerProcessor hop scheduling", "[analyzer]") {
+    AnalyzerProcessor::NonRealtimeParameters params;
+    params.fft_size = 1'024;
+    params.overlap = 0.875f;
+
+    AnalyzerProcessor often, rarely;
+    often.setNonRealtimeParameters(params);
+    rarely.setNonRealtimeParameters(params);
+
+    // One block per hop. In between hops the levels keep moving towards the previous hop's, so
+    // analyzing in the middle of a hop isn't expected to match exactly.
+    const auto sine = makeSineWave(3'000.f, params.sample_rate, 8'192);
+    constexpr uint32_t block_size = 128;
+    for (uint32_t start = 0; start < sine.getNumFrames(); start += block_size) {
+        const auto block = sine.getView().getFrameRange({ start, start + block_size });
+        often.processAudio(block);
+        rarely.processAudio(block);
+
+        often.processAnalyzer(0.001);
+    }
+
+    rarely.processAnalyzer(1.0);
+    often.processAnalyzer(0.001);
+
+    const auto& often_bands = often.bands();
+    const auto& rarely_bands = rarely.bands();
+    REQUIRE(often_bands.size() == rarely_bands.size());
+    for (size_t i = 0; i < often_bands.size(); ++i)
+        REQUIRE(often_bands[i].dB == Catch::Approx(rarely_bands[i].dB).margin(1e-4));
+}
+
 // Tests the frequency band formation and distribution
 TEST_CASE("AnalyzerProcessor frequency band distribution", "[analyzer]") {
     AnalyzerProcessor analyzer;
@@ -211,6 +252,12 @@ TEST_CASE("AnalyzerProcessor frequency band distribution", "[analyzer]") {
     for (size_t i = 1; i < bands.size(); ++i) {
         REQUIRE(bands[i].bins.front() > bands[i - 1].bins.back());
     }
+
+    // Verify the bands form one contiguous run of bins, with x positions in ascending order
+    for (size_t i = 1; i < bands.size(); ++i) {
+        REQUIRE(bands[i].bins.front() == bands[i - 1].bins.back() + 1);
+        REQUIRE(bands[i].x > bands[i - 1].x);
+    }
 }
 
 // Tests the line smoothing functionality at different settings
@@ -249,3 +296,709 @@ TEST_CASE("AnalyzerProcessor line smoothing", "[analyzer]") {
         REQUIRE(line.size() > bands.size() * 4);
     }
 }
+
+TEST_CASE("AnalyzerProcessor split line output", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    {
+        const auto& p = analyzer.nonRealtimeParameters();
+        analyzer.processAudio(makeSineWave(1'000.f, p.sample_rate, 4'096));
+        analyzer.processAnalyzer(0.01);
+    }
+
+    // The compatibility line is the same data, interleaved
+    const auto xs = analyzer.xs();
+    const auto ys = analyzer.ys();
+    const auto& line = analyzer.spectrumLine();
+    REQUIRE(xs.size() == ys.size());
+    REQUIRE(line.size() == xs.size());
+    for (size_t i = 0; i < line.size(); ++i) {
+        REQUIRE(line[i].x == xs[i]);
+        REQUIRE(line[i].y == ys[i]);
+    }
+
+    const auto version = analyzer.xsVersion();
+    const std::vector<float> xs_before(xs.begin(), xs.end());
+
+    SECTION("Version stays put while x doesn't change") {
+        auto params = analyzer.nonRealtimeParameters();
+        params.window_type = tb::WindowType::Hann;
+        analyzer.setNonRealtimeParameters(params);
+        analyzer.reset();
+        analyzer.processAudio(choc::buffer::ChannelArrayBuffer<float>(1, 4'096));
+        analyzer.processAnalyzer(0.01);
+
+        REQUIRE(analyzer.xsVersion() == version);
+        REQUIRE(std::ranges::equal(analyzer.xs(), xs_before));
+    }
+
+    SECTION("Version changes with the band layout") {
+        auto params = analyzer.nonRealtimeParameters();
+        params.target_num_bands /= 2;
+        analyzer.setNonRealtimeParameters(params);
+
+        REQUIRE(analyzer.xsVersion() != version);
+        REQUIRE(analyzer.xs().size() < xs_before.size());
+        REQUIRE(analyzer.spectrumLine().size() == analyzer.xs().size());
+    }
+}
+
+TEST_CASE("AnalyzerProcessor line resolution", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    const auto run = [&] {
+        analyzer.reset();
+        const auto& p = analyzer.nonRealtimeParameters();
+        analyzer.processAudio(makeSineWave(10'000.f, p.sample_rate, 8'192));
+        analyzer.processAnalyzer(0.01);
+        return std::vector<float>(analyzer.ys().begin(), analyzer.ys().end());
+    };
+
+    auto params = analyzer.nonRealtimeParameters();
+    params.target_num_bands = 600;
+    params.line_interpolation_steps = 10;
+    analyzer.setNonRealtimeParameters(params);
+
+    const auto full_detail = run();
+    const auto full_peak = *std::ranges::max_element(full_detail);
+
+    SECTION("Narrow displays get about 2 points per column, keeping the peaks") {
+        const auto version = analyzer.xsVersion();
+        analyzer.setLineResolution(110);
+        REQUIRE(analyzer.xsVersion() != version);
+
+        const auto ys = run();
+        REQUIRE(ys.size() == analyzer.xs().size());
+        REQUIRE(ys.size() < full_detail.size() / 10);
+
+        // The bands get reduced before interpolating, so only a few points get evaluated per column
+        REQUIRE(ys.size() <= 4 * 110);
+        REQUIRE(*std::ranges::max_element(ys) == Catch::Approx(full_peak).margin(0.02));
+
+        // The x values stay in order, so the line never folds back on itself
+        REQUIRE(std::ranges::is_sorted(analyzer.xs()));
+    }
+
+    SECTION("Wide displays keep the full detail where it can be resolved") {
+        analyzer.setLineResolution(100'000);
+        REQUIRE(run().size() == full_detail.size());
+    }
+
+    SECTION("The spline only gets evaluated about once per column") {
+        // The widest gap is the one just above DC, which mustn't set the steps of every other gap
+        for (const auto num_columns : { 110, 440, 1'760 }) {
+            analyzer.setLineResolution(num_columns);
+            const auto engine = analyzer.prepareEngine(params);
+
+            INFO("Columns: " << num_columns);
+            REQUIRE(engine->line_segments.size() == engine->line_x.size());
+            REQUIRE(engine->line_segments.size() <= static_cast<size_t>(4 * num_columns));
+        }
+    }
+
+    SECTION("Zoomed in views only lay out the bands in view") {
+        // The sine at 10 kHz sits at about x = 0.855
+        analyzer.setLineResolution(110, 0.83f, 0.88f);
+        const auto ys = run();
+        const auto xs = analyzer.xs();
+        REQUIRE(ys.size() <= 4 * 110);
+        REQUIRE(xs.front() <= 0.83f);
+        REQUIRE(xs.back() >= 0.88f);
+        REQUIRE(xs.back() < 0.9f);
+        REQUIRE(*std::ranges::max_element(ys) == Catch::Approx(full_peak).margin(0.02));
+
+        // However far in, the line stays about as wide as the display
+        analyzer.setLineResolution(110, 0.85f, 0.8501f);
+        REQUIRE(run().size() <= 4 * 110);
+        REQUIRE(analyzer.prepareEngine(params)->line_segments.size() <= 4 * 110);
+    }
+
+    SECTION("Carries over to new engines") {
+        analyzer.setLineResolution(110);
+        const auto num_points = run().size();
+
+        analyzer.setNonRealtimeParameters(params);
+        REQUIRE(run().size() == num_points);
+
+        analyzer.setLineResolution(0);
+        REQUIRE(run().size() == full_detail.size());
+    }
+}
+
+// Tests that the analysis thread keeps producing frames without processAnalyzer doing the work
+TEST_CASE("AnalyzerProcessor analysis thread", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    {
+        const auto& p = analyzer.nonRealtimeParameters();
+        analyzer.processAudio(makeSineWave(1'000.f, p.sample_rate, 4'096));
+    }
+
+    analyzer.startAnalysisThread(200.0);
+    REQUIRE(analyzer.isAnalysisThreadRunning());
+
+    const auto hasNonMinimumValues = [&] {
+        return std::ranges::any_of(analyzer.bands(), [&](const auto& band) { return band.dB > analyzer.minDb() + 1.f; });
+    };
+
+    // Poll rather than wait a fixed time, so that a slow machine doesn't fail the test & a fast
+    // one doesn't wait for nothing. Each call only picks up the newest finished frame.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        analyzer.processAnalyzer(0.0);
+        if (hasNonMinimumValues() && analyzer.analysisLoad() > 0.0f)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(hasNonMinimumValues());
+    REQUIRE(analyzer.analysisLoad() > 0.0f);
+
+    // The rate can change on the fly
+    analyzer.setAnalysisRate(30.0);
+    REQUIRE(analyzer.analysisRate() == 30.0);
+
+    // Reconfiguring while the thread is running must be safe
+    {
+        auto params = analyzer.nonRealtimeParameters();
+        params.fft_size = 8'192;
+        analyzer.setNonRealtimeParameters(params);
+    }
+
+    analyzer.stopAnalysisThread();
+    REQUIRE_FALSE(analyzer.isAnalysisThreadRunning());
+}
+
+// Tests that reconfiguring never stalls or breaks a concurrently running audio thread
+TEST_CASE("AnalyzerProcessor reconfiguration while processing audio", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    const auto sample_rate = analyzer.nonRealtimeParameters().sample_rate;
+    const auto sine = makeSineWave(1'000.f, sample_rate, 44'100);
+
+    std::atomic<bool> stop_audio = false;
+    std::atomic<int> num_blocks = 0;
+    std::thread audio_thread([&] {
+        constexpr uint32_t block_size = 64;
+        for (uint32_t start = 0; ! stop_audio; start = (start + block_size) % (sine.getNumFrames() - block_size)) {
+            analyzer.processAudio(sine.getView().getFrameRange({ start, start + block_size }));
+            ++num_blocks;
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    });
+
+    // Like dragging the bands slider
+    for (int num_bands = 64; num_bands <= 512; num_bands += 16) {
+        auto params = analyzer.nonRealtimeParameters();
+        params.target_num_bands = num_bands;
+        analyzer.setNonRealtimeParameters(params);
+        analyzer.processAnalyzer(0.0);
+    }
+
+    // Let the last engine receive a few FFT windows worth of audio
+    const auto blocks_after_reconfiguration = num_blocks.load();
+    while (num_blocks - blocks_after_reconfiguration < 300)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    stop_audio = true;
+    audio_thread.join();
+
+    analyzer.processAnalyzer(0.0);
+
+    float max_dB = analyzer.minDb();
+    float max_x = 0.0f;
+    for (const auto& band : analyzer.bands()) {
+        if (band.dB > max_dB) {
+            max_dB = band.dB;
+            max_x = band.x;
+        }
+    }
+
+    // The loudest band should be the one at 1 kHz
+    const auto& p = analyzer.nonRealtimeParameters();
+    const auto expected_x = std::log2(1'000.f / p.min_frequency) / std::log2(p.max_frequency / p.min_frequency);
+    REQUIRE(max_dB > analyzer.minDb() + 20.f);
+    REQUIRE(max_x == Catch::Approx(expected_x).margin(0.02));
+}
+
+// Tests that mixing for the engine in use carries on through a channel count change, rather than
+// dropping audio while the new engine gets built
+TEST_CASE("AnalyzerProcessor channel count change while processing audio", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    auto params = analyzer.nonRealtimeParameters();
+    auto mono = analyzer.prepareEngine(params);
+    analyzer.setEngine(mono);
+
+    // Like a plugin switching from a mono sum to left & right
+    params.num_channels = 2;
+    params.channel_routing = 1;
+    params.fft_size = 32'768;
+
+    const auto sine = makeSineWave(1'000.f, params.sample_rate, 64);
+    choc::buffer::ChannelArrayBuffer<float> mix(2, 64);
+    for (choc::buffer::ChannelCount channel = 0; channel < 2; ++channel)
+        std::copy_n(sine.getIterator(0).sample, 64, mix.getIterator(channel).sample);
+
+    std::atomic<bool> stop_audio = false;
+    std::atomic<int> num_blocks = 0;
+    uint64_t num_frames = 0;
+    std::thread audio_thread([&] {
+        while (! stop_audio) {
+            analyzer.processAudio([&](const AnalyzerProcessor::NonRealtimeParameters& engine_params) {
+                const auto num_channels = engine_params.channel_routing == 1 ? 2u : 1u;
+                return mix.getView().getChannelRange({ 0, num_channels });
+            });
+
+            num_frames += mix.getNumFrames();
+            ++num_blocks;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    const auto wait_for_blocks = [&](int count) {
+        const auto start = num_blocks.load();
+        while (num_blocks - start < count)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    // The audio keeps coming in while the new engine gets built
+    wait_for_blocks(20);
+    auto stereo = std::async(std::launch::async, [&] { return analyzer.prepareEngine(params); }).get();
+    wait_for_blocks(20);
+    analyzer.setEngine(stereo);
+    wait_for_blocks(20);
+
+    stop_audio = true;
+    audio_thread.join();
+
+    // Every frame went to one engine or the other
+    REQUIRE(stereo->sample_ring->writePosition() > 0);
+    REQUIRE(mono->sample_ring->writePosition() + stereo->sample_ring->writePosition() == num_frames);
+    REQUIRE(analyzer.numChannels() == 2);
+}
+
+// Tests building an engine off to the side and handing it over later
+TEST_CASE("AnalyzerProcessor reconfiguration keeps the band levels", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    const auto peak_band = [&] {
+        const auto bands = analyzer.bands();
+        return *std::ranges::max_element(bands, {}, &AnalyzerProcessor::Band::dB);
+    };
+
+    {
+        const auto& p = analyzer.nonRealtimeParameters();
+        analyzer.processAudio(makeSineWave(1'000.f, p.sample_rate, 8'192));
+        analyzer.processAnalyzer(0.01);
+    }
+
+    const auto before = peak_band();
+    REQUIRE(before.dB > analyzer.minDb() + 20.0f);
+
+    // No new audio comes in, so whatever the bands show now was carried over
+    auto params = analyzer.nonRealtimeParameters();
+    params.target_num_bands = 130;
+    params.window_type = tb::WindowType::Hann;
+    analyzer.setNonRealtimeParameters(params);
+
+    const auto after = peak_band();
+    REQUIRE(analyzer.bands().size() < 200);
+    REQUIRE(after.dB > analyzer.minDb() + 20.0f);
+    REQUIRE(after.x == Catch::Approx(before.x).margin(0.01));
+    REQUIRE(*std::ranges::max_element(analyzer.ys()) > 0.2f);
+
+    SECTION("Added channels start at the floor") {
+        params.num_channels = 2;
+        analyzer.setNonRealtimeParameters(params);
+        REQUIRE(analyzer.numChannels() == 2);
+        REQUIRE(peak_band().dB == after.dB);
+        for (const auto& band : analyzer.bands(1))
+            REQUIRE(band.dB == analyzer.minDb());
+    }
+
+    // An explicit reset still starts over
+    analyzer.reset();
+    for (const auto& band : analyzer.bands())
+        REQUIRE(band.dB == analyzer.minDb());
+}
+
+TEST_CASE("AnalyzerProcessor engine built on another thread", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    const auto num_bands_before = analyzer.bands().size();
+
+    auto params = analyzer.nonRealtimeParameters();
+    params.target_num_bands = 64;
+    params.fft_size = 16'384;
+
+    auto build = std::async(std::launch::async, [&] { return analyzer.prepareEngine(params); });
+
+    // The analyzer keeps running on its current engine in the meantime
+    const auto sine = makeSineWave(1'000.f, params.sample_rate, 4'096);
+    analyzer.processAudio(sine);
+    analyzer.processAnalyzer(0.1);
+    REQUIRE(analyzer.bands().size() == num_bands_before);
+    REQUIRE(analyzer.nonRealtimeParameters().target_num_bands != 64);
+
+    analyzer.setEngine(build.get());
+    REQUIRE(analyzer.nonRealtimeParameters() == params);
+    REQUIRE(analyzer.bands().size() < num_bands_before);
+
+    // The levels carry over onto the new bands
+    const auto bands = analyzer.bands();
+    REQUIRE((*std::ranges::max_element(bands, {}, &AnalyzerProcessor::Band::dB)).dB > analyzer.minDb());
+}
+
+TEST_CASE("AnalyzerProcessor engine cache", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    const auto params_a = analyzer.nonRealtimeParameters();
+    auto params_b = params_a;
+    params_b.fft_size = 16'384;
+
+    // The constructor already counted a miss for the initial engine
+    analyzer.setNonRealtimeParameters(params_b);
+    REQUIRE(analyzer.engineCacheStats().misses == 2);
+    REQUIRE(analyzer.engineCacheStats().hits == 0);
+
+    // Flipping back picks up the engine that got swapped out
+    analyzer.setNonRealtimeParameters(params_a);
+    REQUIRE(analyzer.engineCacheStats().hits == 1);
+    REQUIRE(analyzer.engineCacheStats().size == 1);
+
+    analyzer.setNonRealtimeParameters(params_b);
+    REQUIRE(analyzer.engineCacheStats().hits == 2);
+    REQUIRE(analyzer.engineCacheStats().hitRate() == Catch::Approx(0.5));
+
+    SECTION("Cached engines start over from the current audio") {
+        analyzer.setNonRealtimeParameters(params_a);
+        analyzer.reset();
+        analyzer.processAudio(makeSineWave(1'000.f, params_a.sample_rate, 8'192));
+        analyzer.processAnalyzer(0.01);
+
+        const auto bands = analyzer.bands();
+        const auto peak = *std::ranges::max_element(bands, {}, &AnalyzerProcessor::Band::dB);
+        const auto peak_freq = (peak.bins.front() + peak.bins.back()) / 2.0 * params_a.sample_rate / params_a.fft_size;
+        REQUIRE(peak_freq == Catch::Approx(1'000.0).epsilon(0.1));
+    }
+
+    SECTION("Capacity is bounded") {
+        analyzer.setEngineCacheCapacity(2);
+        for (const auto num_bands : { 100, 110, 120, 130 }) {
+            auto params = params_a;
+            params.target_num_bands = num_bands;
+            analyzer.setNonRealtimeParameters(params);
+        }
+
+        REQUIRE(analyzer.engineCacheStats().size == 2);
+        REQUIRE(analyzer.takeCachedEngine(params_a) == nullptr);
+
+        analyzer.setEngineCacheCapacity(0);
+        REQUIRE(analyzer.engineCacheStats().size == 0);
+    }
+}
+
+// Tests that a full scale sine at the weighting center frequency reads as 0 dB
+TEST_CASE("AnalyzerProcessor calibration", "[analyzer]") {
+    for (const auto window_type : { tb::WindowType::Hann, tb::WindowType::BlackmanHarris }) {
+        for (const auto fft_size : { 1'024, 8'192 }) {
+            AnalyzerProcessor analyzer;
+            analyzer.setAttackRate(1e6f); // Instant
+
+            // Put the sine right on a bin
+            AnalyzerProcessor::NonRealtimeParameters params;
+            params.sample_rate = 48'000.0;
+            params.fft_size = fft_size;
+            params.window_type = window_type;
+            params.weighting_center_frequency = static_cast<float>(params.sample_rate / fft_size * (fft_size / 48));
+            analyzer.setNonRealtimeParameters(params);
+
+            analyzer.processAudio(makeSineWave(params.weighting_center_frequency, params.sample_rate, fft_size * 2));
+            analyzer.processAnalyzer(0.1);
+
+            float max_dB = analyzer.minDb();
+            for (const auto& band : analyzer.bands())
+                max_dB = std::max(max_dB, band.dB);
+
+            INFO("FFT size: " << fft_size);
+            REQUIRE(max_dB == Catch::Approx(0.0f).margin(0.05f));
+        }
+    }
+}
+
+// Tests that the levels only fall once audio stops coming in for a while, without running FFTs
+TEST_CASE("AnalyzerProcessor stalled audio", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+
+    const auto& p = analyzer.nonRealtimeParameters();
+    analyzer.processAudio(makeSineWave(1'000.f, p.sample_rate, 8'192));
+    analyzer.processAnalyzer(0.01);
+
+    const auto peakDb = [&] {
+        float max_dB = analyzer.minDb();
+        for (const auto& band : analyzer.bands())
+            max_dB = std::max(max_dB, band.dB);
+
+        return max_dB;
+    };
+
+    const auto initial_peak_dB = peakDb();
+    REQUIRE(initial_peak_dB > analyzer.minDb() + 20.f);
+
+    // A short gap, like between two large host blocks, holds the levels
+    analyzer.processAnalyzer(0.1);
+    REQUIRE(peakDb() == initial_peak_dB);
+
+    // A stall lets them fall all the way
+    for (int i = 0; i < 200; ++i)
+        analyzer.processAnalyzer(0.1);
+
+    REQUIRE(peakDb() == Catch::Approx(analyzer.minDb()).margin(0.01f));
+}
+
+// Tests that a settled analyzer stops making new frames until something changes
+TEST_CASE("AnalyzerProcessor convergence", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    const auto& p = analyzer.nonRealtimeParameters();
+
+    // Without any audio it settles right away, as all bands start out at the minimum
+    analyzer.processAnalyzer(0.01);
+    REQUIRE(analyzer.processAnalyzer(0.01) == false);
+    REQUIRE(analyzer.isConverged());
+
+    // New audio wakes it up
+    analyzer.processAudio(makeSineWave(1'000.f, p.sample_rate, 8'192));
+    REQUIRE(analyzer.processAnalyzer(0.01));
+    REQUIRE_FALSE(analyzer.isConverged());
+
+    // So does changing the range
+    while (analyzer.processAnalyzer(0.01)) { }
+    analyzer.setMaxDb(0.0f);
+    REQUIRE(analyzer.processAnalyzer(0.01));
+}
+
+// Tests that each channel gets its own spectrum out of the batched analysis
+TEST_CASE("AnalyzerProcessor multichannel", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    auto p = analyzer.nonRealtimeParameters();
+    p.num_channels = 3;
+    p.weighting_db_per_octave = 0.0f;
+    analyzer.setNonRealtimeParameters(p);
+    REQUIRE(analyzer.numChannels() == 3);
+
+    // A different tone per channel, the last channel staying silent
+    const std::array frequencies { 200.0, 5'000.0 };
+    choc::buffer::ChannelArrayBuffer<float> audio(3, 8'192);
+    for (size_t channel = 0; channel < frequencies.size(); ++channel) {
+        const auto sine = makeSineWave(frequencies[channel], p.sample_rate, 8'192);
+        std::copy_n(sine.getIterator(0).sample, 8'192, audio.getIterator(static_cast<uint32_t>(channel)).sample);
+    }
+
+    // Blocks with the wrong channel count get ignored
+    analyzer.processAudio(makeSineWave(1'000.0, p.sample_rate, 8'192));
+    analyzer.processAnalyzer(0.01);
+    for (int channel = 0; channel < 3; ++channel) {
+        for (const auto& band : analyzer.bands(channel))
+            REQUIRE(band.dB == analyzer.minDb());
+    }
+
+    analyzer.processAudio(audio);
+    analyzer.processAnalyzer(0.01);
+
+    const auto min_log = std::log2(p.min_frequency);
+    const auto max_log = std::log2(p.max_frequency);
+    for (size_t channel = 0; channel < frequencies.size(); ++channel) {
+        const auto bands = analyzer.bands(static_cast<int>(channel));
+        const auto peak = std::ranges::max_element(bands, {}, &AnalyzerProcessor::Band::dB);
+        const auto peak_frequency = std::exp2(min_log + (*peak).x * (max_log - min_log));
+
+        INFO("Channel: " << channel);
+        REQUIRE((*peak).dB > -3.0f);
+        REQUIRE(peak_frequency == Catch::Approx(frequencies[channel]).epsilon(0.05));
+    }
+
+    for (const auto& band : analyzer.bands(2))
+        REQUIRE(band.dB == analyzer.minDb());
+
+    // All channels share the x values, but each has its own line
+    const auto xs = analyzer.xs();
+    for (int channel = 0; channel < 3; ++channel)
+        REQUIRE(analyzer.ys(channel).size() == xs.size());
+
+    REQUIRE_FALSE(std::ranges::equal(analyzer.ys(0), analyzer.ys(1)));
+    REQUIRE(std::ranges::all_of(analyzer.ys(2), [](float y) { return y == Catch::Approx(0.0f).margin(1e-5); }));
+
+    // Going back to mono keeps the first channel's levels
+    const auto peak_dB = [&analyzer] {
+        return std::ranges::max(analyzer.bands() | std::views::transform([](const auto& band) { return band.dB; }));
+    };
+
+    const auto first_channel_peak_dB = peak_dB();
+    p.num_channels = 1;
+    analyzer.setNonRealtimeParameters(p);
+    REQUIRE(analyzer.numChannels() == 1);
+    REQUIRE(peak_dB() == first_channel_peak_dB);
+}
+
+TEST_CASE("AnalyzerProcessor transfer function", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    REQUIRE(analyzer.transferFunction().empty());
+
+    auto p = analyzer.nonRealtimeParameters();
+    p.num_channels = 2;
+    p.transfer_function = true;
+    analyzer.setNonRealtimeParameters(p);
+
+    // White noise as the reference in the last channel, the first channel being the "system" output
+    std::mt19937 rng(8642);
+    std::normal_distribution<float> noise(0.0f, 0.3f);
+    const auto process = [&](auto&& system) {
+        choc::buffer::ChannelArrayBuffer<float> audio(2, 32'768);
+        auto* y = audio.getIterator(0).sample;
+        auto* x = audio.getIterator(1).sample;
+        for (int i = 0; i < 32'768; ++i) {
+            x[i] = noise(rng);
+            y[i] = system(x[i]);
+        }
+
+        analyzer.processAudio(audio);
+        analyzer.processAnalyzer(0.01);
+    };
+
+    // The lowest band only holds DC at this FFT size, which is left out, see the DC section below
+    const auto in_range = [&] { return analyzer.transferFunction() | std::views::drop(1); };
+
+    SECTION("A gain shows up as a flat magnitude with full coherence") {
+        process([](float x) { return 0.5f * x; });
+
+        REQUIRE(analyzer.transferFunction().size() == analyzer.bands().size());
+        for (const auto& band : in_range()) {
+            INFO("x: " << band.x);
+            REQUIRE(band.magnitude_dB == Catch::Approx(-6.0206f).margin(0.01));
+            REQUIRE(band.phase == Catch::Approx(0.0f).margin(1e-3));
+            REQUIRE(band.coherence == Catch::Approx(1.0f).margin(1e-3));
+        }
+    }
+
+    SECTION("An inverted polarity shows up in the phase") {
+        process([](float x) { return -x; });
+
+        for (const auto& band : in_range()) {
+            REQUIRE(band.magnitude_dB == Catch::Approx(0.0f).margin(0.01));
+            REQUIRE(std::abs(band.phase) == Catch::Approx(std::numbers::pi_v<float>).margin(1e-3));
+        }
+    }
+
+    SECTION("Unrelated signals have a low coherence") {
+        std::normal_distribution<float> other(0.0f, 0.3f);
+        process([&](float) { return other(rng); });
+
+        float coherence_sum = 0.0f;
+        const auto transfer = analyzer.transferFunction();
+        for (const auto& band : transfer)
+            coherence_sum += band.coherence;
+
+        REQUIRE(coherence_sum / static_cast<float>(transfer.size()) < 0.3f);
+    }
+
+    SECTION("A delay doesn't lower the magnitude or coherence") {
+        // y[n] = x[n - 96], which turns the phase by more than a full cycle within the wider bands
+        p.fft_size = 4'096;
+        analyzer.setNonRealtimeParameters(p);
+
+        std::array<float, 96> delay {};
+        size_t delay_position = 0;
+        process([&](float x) {
+            const auto y = std::exchange(delay[delay_position], x);
+            delay_position = (delay_position + 1) % delay.size();
+            return y;
+        });
+
+        for (const auto& band : in_range()) {
+            INFO("x: " << band.x);
+            REQUIRE(band.magnitude_dB == Catch::Approx(0.0f).margin(0.5));
+            REQUIRE(band.coherence == Catch::Approx(1.0f).margin(0.1));
+        }
+    }
+
+    SECTION("DC & the bins below the range stay out of the lowest band") {
+        // At this size, the lowest band holds DC, the bins below the range and a single bin in
+        // range. Differentiating makes the gain rise with frequency from nothing at DC, so taking
+        // in any of the others would pull the band below that one bin's gain.
+        p.fft_size = 65'536;
+        analyzer.setNonRealtimeParameters(p);
+
+        float previous = 0.0f;
+        process([&](float x) { return x - std::exchange(previous, x); });
+
+        const auto engine = analyzer.prepareEngine(p);
+        const auto in_range_bin = engine->band_bin_offsets[1] - 1;
+        REQUIRE(engine->bin_power_weights[static_cast<size_t>(in_range_bin)] > 0.0f);
+        REQUIRE(engine->bin_power_weights[static_cast<size_t>(in_range_bin) - 1] == 0.0f);
+
+        const auto gain = 2.0 * std::sin(std::numbers::pi * in_range_bin / p.fft_size);
+        const auto band = analyzer.transferFunction()[0];
+        REQUIRE(band.magnitude_dB == Catch::Approx(20.0 * std::log10(gain)).margin(0.5));
+        REQUIRE(band.coherence == Catch::Approx(1.0f).margin(0.05));
+    }
+
+    SECTION("Silence in the reference leaves the floor") {
+        choc::buffer::ChannelArrayBuffer<float> audio(2, 32'768);
+        audio.clear();
+        auto* y = audio.getIterator(0).sample;
+        for (int i = 0; i < 32'768; ++i)
+            y[i] = noise(rng);
+
+        analyzer.processAudio(audio);
+        analyzer.processAnalyzer(0.01);
+
+        for (const auto& band : analyzer.transferFunction()) {
+            REQUIRE(band.magnitude_dB == analyzer.minDb());
+            REQUIRE(band.coherence == 0.0f);
+        }
+    }
+
+    SECTION("A reset goes back to the floor") {
+        process([](float x) { return x; });
+        analyzer.reset();
+
+        for (const auto& band : analyzer.transferFunction()) {
+            REQUIRE(band.magnitude_dB == analyzer.minDb());
+            REQUIRE(band.coherence == 0.0f);
+        }
+    }
+
+    // Turning it off again empties the view
+    p.transfer_function = false;
+    analyzer.setNonRealtimeParameters(p);
+    REQUIRE(analyzer.transferFunction().empty());
+}
+
+// Tests that the levels keep moving in between hops, rather than in steps of a whole hop
+TEST_CASE("AnalyzerProcessor ballistics between hops", "[analyzer]") {
+    AnalyzerProcessor analyzer;
+    auto p = analyzer.nonRealtimeParameters();
+    p.fft_size = 65'536;
+    p.overlap = 0.75f;
+    analyzer.setNonRealtimeParameters(p);
+
+    // A hop is 16'384 samples, so the first one completes with the 16th block
+    const auto sine = makeSineWave(1'000.0, p.sample_rate, 32'768);
+    constexpr uint32_t block_size = 1'024;
+    std::vector<float> levels;
+    for (uint32_t start = 0; start < sine.getNumFrames(); start += block_size) {
+        analyzer.processAudio(sine.getView().getFrameRange({ start, start + block_size }));
+        analyzer.processAnalyzer(block_size / p.sample_rate);
+        levels.push_back(std::ranges::max(analyzer.bands() |
+                                          std::views::transform([](const auto& band) { return band.dB; })));
+    }
+
+    for (size_t i = 0; i < 15; ++i)
+        REQUIRE(levels[i] == analyzer.minDb());
+
+    // After the first hop, the level rises with every block until the next hop
+    REQUIRE(levels[15] > analyzer.minDb());
+    for (size_t i = 16; i < 24; ++i) {
+        INFO("Block: " << i);
+        REQUIRE(levels[i] > levels[i - 1]);
+    }
+}
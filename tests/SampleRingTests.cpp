@@ -0,0 +1,101 @@
+#include "SampleRing.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Sample i of the stream has the value i, which makes it easy to tell what got read
+std::vector<float> makeRamp(uint64_t start, int count) {
+    std::vector<float> samples(count);
+    std::iota(samples.begin(), samples.end(), static_cast<float>(start));
+    return samples;
+}
+
+}
+
+TEST_CASE("SampleRing capacity", "[ring]") {
+    REQUIRE(SampleRing(1'000).capacity() == 1'024);
+    REQUIRE(SampleRing(1'024).capacity() == 1'024);
+    REQUIRE(SampleRing(0).capacity() == 1);
+    REQUIRE(SampleRing(16, 3).numChannels() == 3);
+}
+
+TEST_CASE("SampleRing reads", "[ring]") {
+    SampleRing ring(16);
+    std::vector<float> dest(16, -1.0f);
+
+    SECTION("Samples before the start of the stream read as silence") {
+        ring.write(makeRamp(0, 5).data(), 5);
+        REQUIRE(ring.writePosition() == 5);
+        REQUIRE(ring.read(dest.data(), 8, 5));
+        REQUIRE(dest[0] == 0.0f);
+        REQUIRE(dest[1] == 0.0f);
+        REQUIRE(dest[2] == 0.0f);
+        for (int i = 0; i < 5; ++i)
+            REQUIRE(dest[3 + i] == static_cast<float>(i));
+
+        // Nothing written at all
+        SampleRing empty(16);
+        REQUIRE(empty.read(dest.data(), 16, 0));
+        for (const auto sample : dest)
+            REQUIRE(sample == 0.0f);
+    }
+
+    SECTION("Reads across the wrap-around") {
+        // Blocks of odd sizes make the reads & writes straddle the end of the buffer
+        uint64_t position = 0;
+        for (int block = 0; block < 20; ++block) {
+            const auto num_samples = 1 + block % 7;
+            ring.write(makeRamp(position, num_samples).data(), num_samples);
+            position += static_cast<uint64_t>(num_samples);
+
+            const auto count = static_cast<int>(std::min<uint64_t>(position, 16));
+            REQUIRE(ring.read(dest.data(), count, position));
+            for (int i = 0; i < count; ++i) {
+                INFO("Block: " << block << ", sample: " << i);
+                REQUIRE(dest[i] == static_cast<float>(position - count + i));
+            }
+        }
+    }
+
+    SECTION("Writes larger than the capacity keep the most recent samples") {
+        ring.write(makeRamp(0, 3).data(), 3);
+        ring.write(makeRamp(3, 40).data(), 40);
+        REQUIRE(ring.writePosition() == 43);
+        REQUIRE(ring.read(dest.data(), 16, 43));
+        for (int i = 0; i < 16; ++i)
+            REQUIRE(dest[i] == static_cast<float>(27 + i));
+    }
+
+    SECTION("Reads fail once the writer has lapped the reader") {
+        ring.write(makeRamp(0, 12).data(), 12);
+        REQUIRE(ring.read(dest.data(), 8, 12));
+
+        // The range from 4 to 12 survives until the writer gets more than a capacity past its start
+        ring.write(makeRamp(12, 8).data(), 8);
+        REQUIRE(ring.read(dest.data(), 8, 12));
+        ring.write(makeRamp(20, 1).data(), 1);
+        REQUIRE(ring.read(dest.data(), 8, 21));
+        REQUIRE_FALSE(ring.read(dest.data(), 8, 12));
+
+        // Asking for more than fits never works
+        REQUIRE_FALSE(ring.read(dest.data(), 17, 20));
+    }
+}
+
+TEST_CASE("SampleRing channels", "[ring]") {
+    SampleRing ring(8, 2);
+    const auto left = makeRamp(0, 11);
+    const auto right = makeRamp(100, 11);
+    const float* channels[] = { left.data(), right.data() };
+    ring.write(channels, 11);
+
+    std::vector<float> dest(8);
+    for (int channel = 0; channel < 2; ++channel) {
+        REQUIRE(ring.read(dest.data(), 8, 11, channel));
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(dest[i] == static_cast<float>(channel * 100 + 3 + i));
+    }
+}
@@ -0,0 +1,89 @@
+#include "TripleBuffer.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <thread>
+
+TEST_CASE("TripleBuffer handoff", "[triple-buffer]") {
+    TripleBuffer<int> buffer;
+
+    SECTION("Nothing to read before the first publish") {
+        REQUIRE_FALSE(buffer.update());
+    }
+
+    SECTION("A published buffer reaches the reader once") {
+        buffer.writeBuffer() = 1;
+        buffer.publish();
+        REQUIRE(buffer.update());
+        REQUIRE(buffer.readBuffer() == 1);
+
+        // Stays put until something new gets published
+        REQUIRE_FALSE(buffer.update());
+        REQUIRE(buffer.readBuffer() == 1);
+    }
+
+    SECTION("Reads get the latest of several publishes") {
+        for (int i = 1; i <= 5; ++i) {
+            buffer.writeBuffer() = i;
+            buffer.publish();
+        }
+
+        REQUIRE(buffer.update());
+        REQUIRE(buffer.readBuffer() == 5);
+        REQUIRE_FALSE(buffer.update());
+    }
+
+    SECTION("Interleaved publishes & reads never hand out a stale or reused slot") {
+        // Covers every pattern of up to 3 publishes between reads
+        int value = 0;
+        for (int round = 0; round < 64; ++round) {
+            const auto num_publishes = round % 4;
+            for (int i = 0; i < num_publishes; ++i) {
+                buffer.writeBuffer() = ++value;
+                buffer.publish();
+
+                // The producer never gets handed the slot the reader holds
+                REQUIRE(&buffer.writeBuffer() != &buffer.readBuffer());
+            }
+
+            INFO("Round: " << round);
+            REQUIRE(buffer.update() == (num_publishes > 0));
+            if (num_publishes > 0)
+                REQUIRE(buffer.readBuffer() == value);
+        }
+    }
+}
+
+TEST_CASE("TripleBuffer concurrent use", "[triple-buffer]") {
+    // Each buffer holds a value & its negation, so a torn read shows up as a mismatch. The values
+    // only ever go up, so a stale read shows up as going backwards.
+    struct Payload {
+        int64_t value = 0;
+        int64_t check = 0;
+    };
+
+    TripleBuffer<Payload> buffer;
+    constexpr int64_t num_publishes = 200'000;
+
+    std::thread producer([&buffer] {
+        for (int64_t i = 1; i <= num_publishes; ++i) {
+            buffer.writeBuffer() = { i, -i };
+            buffer.publish();
+        }
+    });
+
+    int64_t last = 0;
+    bool consistent = true;
+    while (last < num_publishes) {
+        if (! buffer.update())
+            continue;
+
+        const auto& payload = buffer.readBuffer();
+        consistent = consistent && payload.check == -payload.value && payload.value > last;
+        last = payload.value;
+    }
+
+    producer.join();
+    REQUIRE(consistent);
+    REQUIRE(last == num_publishes);
+}